@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Function {
+
+template <typename Signature, std::size_t t_capacity = 4 * sizeof(void*)>
+class InplaceFunction;
+
+/**
+ * Non-allocating callable wrapper with a fixed inline capacity.
+ *
+ * Only trivially copyable callables are accepted (function pointers and
+ * lambdas capturing pointers, references or other trivially copyable values),
+ * so the wrapper itself stays trivially copyable and calling it is a single
+ * indirect call. Callables that do not fit are rejected at compile time.
+ *
+ *     Function::InplaceFunction<void(int)> f = [this](int value) { onValue(value); };
+ */
+template <typename Result, typename... Args, std::size_t t_capacity>
+class InplaceFunction<Result(Args...), t_capacity> {
+public:
+    static constexpr std::size_t s_capacity = t_capacity;
+    static constexpr std::size_t s_alignment = alignof(std::max_align_t);
+
+    using ResultType = Result;
+    using Invoker = Result (*)(const void*, Args...);
+
+private:
+    template <typename, std::size_t>
+    friend class InplaceFunction;
+
+    alignas(s_alignment) std::byte m_storage[t_capacity] {};
+    Invoker m_invoke = nullptr;
+
+public:
+    InplaceFunction() = default;
+    InplaceFunction(std::nullptr_t) {}
+
+    template <typename Callable>
+        requires(!std::is_same_v<std::decay_t<Callable>, InplaceFunction>
+            && std::is_invocable_r_v<Result, const std::decay_t<Callable>&, Args...>)
+    InplaceFunction(Callable&& callable) {
+        using Stored = std::decay_t<Callable>;
+        static_assert(sizeof(Stored) <= t_capacity, "Callable does not fit into InplaceFunction, increase the capacity");
+        static_assert(alignof(Stored) <= s_alignment, "Callable is over-aligned for InplaceFunction");
+        static_assert(std::is_trivially_copyable_v<Stored> && std::is_trivially_destructible_v<Stored>,
+            "InplaceFunction only stores trivially copyable callables, capture pointers instead of owning objects");
+
+        ::new (static_cast<void*>(m_storage)) Stored(std::forward<Callable>(callable));
+        m_invoke = [](const void* storage, Args... args) -> Result {
+            return std::invoke(*static_cast<const Stored*>(storage), std::forward<Args>(args)...);
+        };
+    }
+
+    // Widening to a larger capacity copies the stored callable, it does not wrap it.
+    template <std::size_t t_otherCapacity>
+        requires(t_otherCapacity < t_capacity)
+    InplaceFunction(const InplaceFunction<Result(Args...), t_otherCapacity>& other)
+        : m_invoke(other.m_invoke) {
+        std::memcpy(m_storage, other.m_storage, t_otherCapacity);
+    }
+
+    Result operator()(Args... args) const {
+        return m_invoke(m_storage, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return m_invoke != nullptr; }
+};
+
+} // namespace Function
@@ -0,0 +1,302 @@
+#include "BrokerList.hpp"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+namespace MQTT {
+
+BrokerList::BrokerList(const std::vector<std::string>& uris, std::uint32_t probeTimeoutMs)
+    : m_probeTimeoutMs(probeTimeoutMs) {
+    if (uris.empty())
+        throw std::invalid_argument("At least one MQTT broker is required");
+    for (const std::string& uri : uris) {
+        std::optional<Endpoint> endpoint = parse(uri);
+        if (!endpoint)
+            ESP_LOGW(s_tag, "Cannot probe broker %s", uri.c_str());
+        m_candidates.push_back({ .uri = uri, .endpoint = std::move(endpoint) });
+    }
+    m_addresses.resize(m_candidates.size());
+}
+
+BrokerList::~BrokerList() {
+    {
+        std::lock_guard<std::mutex> lock(m_refresherMutex);
+        m_stopping = true;
+    }
+    m_refresherWake.notify_one();
+    if (m_refresher.joinable())
+        m_refresher.join();
+}
+
+std::optional<BrokerList::Endpoint> BrokerList::parse(std::string_view uri) {
+    std::size_t separator = uri.find("://");
+    if (separator == std::string_view::npos)
+        return std::nullopt;
+    std::string_view scheme = uri.substr(0, separator);
+    std::string_view authority = uri.substr(separator + 3);
+    authority = authority.substr(0, authority.find('/'));
+    if (std::size_t at = authority.rfind('@'); at != std::string_view::npos)
+        authority.remove_prefix(at + 1);
+
+    std::string_view host = authority;
+    std::string_view port;
+    if (authority.starts_with('[')) {
+        std::size_t end = authority.find(']');
+        if (end == std::string_view::npos)
+            return std::nullopt;
+        host = authority.substr(1, end - 1);
+        if (end + 1 < authority.size() && authority[end + 1] == ':')
+            port = authority.substr(end + 2);
+    } else if (std::size_t colon = authority.find(':'); colon != std::string_view::npos) {
+        host = authority.substr(0, colon);
+        port = authority.substr(colon + 1);
+    }
+    if (host.empty())
+        return std::nullopt;
+
+    std::uint16_t number = 0;
+    if (!port.empty()) {
+        auto [end, error] = std::from_chars(port.data(), port.data() + port.size(), number);
+        if (error != std::errc() || end != port.data() + port.size() || number == 0)
+            return std::nullopt;
+    } else if (scheme == "mqtt") {
+        number = 1883;
+    } else if (scheme == "mqtts") {
+        number = 8883;
+    } else if (scheme == "ws") {
+        number = 80;
+    } else if (scheme == "wss") {
+        number = 443;
+    } else {
+        return std::nullopt;
+    }
+    return Endpoint { std::string(host), number };
+}
+
+void BrokerList::resolve() {
+    std::vector<std::optional<Endpoint>> endpoints;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const Candidate& candidate : m_candidates)
+            endpoints.push_back(candidate.endpoint);
+    }
+
+    for (std::size_t i = 0; i < endpoints.size(); ++i) {
+        if (!endpoints[i])
+            continue;
+
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        std::string port = std::to_string(endpoints[i]->port);
+        if (getaddrinfo(endpoints[i]->host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+            ESP_LOGD(s_tag, "Cannot resolve %s", endpoints[i]->host.c_str());
+            continue;
+        }
+
+        Address address = {};
+        std::memcpy(&address.storage, result->ai_addr, std::min<std::size_t>(result->ai_addrlen, sizeof(address.storage)));
+        address.length = result->ai_addrlen;
+        address.family = result->ai_family;
+        freeaddrinfo(result);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_addresses[i] = address;
+    }
+}
+
+void BrokerList::refresh() {
+    resolve();
+    probe();
+}
+
+void BrokerList::requestRefresh() {
+    std::lock_guard<std::mutex> lock(m_refresherMutex);
+    m_refreshRequested = true;
+    if (!m_refresher.joinable())
+        m_refresher = std::thread([this] { refresherLoop(); });
+    else
+        m_refresherWake.notify_one();
+}
+
+void BrokerList::refresherLoop() {
+    std::unique_lock<std::mutex> lock(m_refresherMutex);
+    for (;;) {
+        m_refresherWake.wait(lock, [this] { return m_refreshRequested || m_stopping; });
+        if (m_stopping)
+            return;
+        m_refreshRequested = false;
+        lock.unlock();
+        refresh();
+        lock.lock();
+    }
+}
+
+// Starts a non-blocking connect to every resolved candidate at once, so a probe takes at most the timeout.
+void BrokerList::probe() {
+    struct Attempt {
+        int fd = -1;
+        std::int64_t start = 0;
+        std::optional<std::uint32_t> rttMs;
+    };
+
+    std::vector<std::optional<Address>> addresses;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        addresses = m_addresses;
+    }
+
+    std::int64_t begin = esp_timer_get_time();
+    std::vector<Attempt> attempts(addresses.size());
+    for (std::size_t i = 0; i < addresses.size(); ++i) {
+        if (!addresses[i])
+            continue;
+
+        const Address& address = *addresses[i];
+        int fd = socket(address.family, SOCK_STREAM, 0);
+        if (fd < 0)
+            continue;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        attempts[i].start = esp_timer_get_time();
+        int ret = ::connect(fd, reinterpret_cast<const sockaddr*>(&address.storage), address.length);
+        if (ret == 0) {
+            attempts[i].rttMs = static_cast<std::uint32_t>((esp_timer_get_time() - attempts[i].start) / 1000);
+            close(fd);
+        } else if (errno == EINPROGRESS) {
+            attempts[i].fd = fd;
+        } else {
+            close(fd);
+        }
+    }
+
+    std::int64_t deadline = esp_timer_get_time() + static_cast<std::int64_t>(m_probeTimeoutMs) * 1000;
+    for (;;) {
+        fd_set writable;
+        FD_ZERO(&writable);
+        int highest = -1;
+        for (const Attempt& attempt : attempts) {
+            if (attempt.fd < 0)
+                continue;
+            FD_SET(attempt.fd, &writable);
+            highest = std::max(highest, attempt.fd);
+        }
+        std::int64_t remaining = deadline - esp_timer_get_time();
+        if (highest < 0 || remaining <= 0)
+            break;
+
+        timeval timeout = {
+            .tv_sec = static_cast<decltype(timeout.tv_sec)>(remaining / 1000000),
+            .tv_usec = static_cast<decltype(timeout.tv_usec)>(remaining % 1000000),
+        };
+        if (::select(highest + 1, nullptr, &writable, nullptr, &timeout) <= 0)
+            break;
+
+        std::int64_t now = esp_timer_get_time();
+        for (Attempt& attempt : attempts) {
+            if (attempt.fd < 0 || !FD_ISSET(attempt.fd, &writable))
+                continue;
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(attempt.fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0)
+                attempt.rttMs = static_cast<std::uint32_t>((now - attempt.start) / 1000);
+            close(attempt.fd);
+            attempt.fd = -1;
+        }
+    }
+
+    for (Attempt& attempt : attempts) {
+        if (attempt.fd >= 0)
+            close(attempt.fd);
+    }
+
+    ++m_probes;
+    m_lastProbeMs = static_cast<std::uint32_t>((esp_timer_get_time() - begin) / 1000);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::size_t i = 0; i < m_candidates.size(); ++i) {
+        m_candidates[i].rttMs = attempts[i].rttMs;
+        if (attempts[i].rttMs)
+            ESP_LOGI(s_tag, "Broker %s answered in %lu ms", m_candidates[i].uri.c_str(), static_cast<unsigned long>(*attempts[i].rttMs));
+        else
+            ESP_LOGI(s_tag, "Broker %s is unreachable", m_candidates[i].uri.c_str());
+    }
+}
+
+bool BrokerList::select() {
+    // For the next selection, which runs on the esp-mqtt task and must neither wait for DNS nor a probe.
+    requestRefresh();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto rank = [](const Candidate& candidate) {
+        return std::make_tuple(!candidate.rttMs, candidate.failures, candidate.rttMs.value_or(0));
+    };
+    // The first of equally ranked candidates wins, so the list order breaks ties.
+    auto best = std::min_element(m_candidates.begin(), m_candidates.end(), [&](const Candidate& a, const Candidate& b) {
+        return rank(a) < rank(b);
+    });
+    if (!best->rttMs) {
+        ESP_LOGW(s_tag, "No broker is reachable, keeping %s", m_candidates[m_current].uri.c_str());
+        return false;
+    }
+
+    auto index = static_cast<std::size_t>(best - m_candidates.begin());
+    if (index == m_current)
+        return false;
+    ESP_LOGI(s_tag, "Switching from %s to %s", m_candidates[m_current].uri.c_str(), best->uri.c_str());
+    m_current = index;
+    ++m_failovers;
+    return true;
+}
+
+void BrokerList::connected() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_candidates[m_current].failures = 0;
+}
+
+void BrokerList::failed() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_candidates[m_current].failures;
+    }
+    // The broker may be gone since the last probe, the reconnect should not rely on it.
+    requestRefresh();
+}
+
+std::size_t BrokerList::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_candidates.size();
+}
+
+std::string BrokerList::current() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_candidates[m_current].uri;
+}
+
+std::vector<BrokerList::Candidate> BrokerList::candidates() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_candidates;
+}
+
+BrokerList::Stats BrokerList::stats() const {
+    return {
+        .probes = m_probes.load(),
+        .failovers = m_failovers.load(),
+        .lastProbeMs = m_lastProbeMs.load(),
+    };
+}
+
+} // namespace MQTT
@@ -0,0 +1,118 @@
+#include "Codec.hpp"
+
+#include <cstdint>
+
+namespace MQTT {
+
+namespace {
+
+// heatshrink takes non-const input buffers but does not modify them.
+std::uint8_t* bytes(std::string_view data) {
+    return reinterpret_cast<std::uint8_t*>(const_cast<char*>(data.data()));
+}
+
+std::uint8_t* bytes(std::string& data) {
+    return reinterpret_cast<std::uint8_t*>(data.data());
+}
+
+} // namespace
+
+bool Codec::isCompressed(std::string_view payload) {
+    return payload.size() >= s_headerSize && payload.starts_with(s_magic);
+}
+
+bool Codec::compress(std::string_view in, std::string& out) {
+    out.resize(in.size());
+    if (out.size() <= s_headerSize)
+        return false;
+
+    out.replace(0, s_magic.size(), s_magic);
+    auto size = static_cast<std::uint32_t>(in.size());
+    for (std::size_t i = 0; i < 4; ++i)
+        out[s_magic.size() + i] = static_cast<char>(size >> (8 * i));
+
+    std::size_t written = s_headerSize;
+    auto drain = [&] {
+        HSE_poll_res res;
+        do {
+            if (written == out.size())
+                return false;
+            std::size_t count = 0;
+            res = heatshrink_encoder_poll(&m_encoder, bytes(out) + written, out.size() - written, &count);
+            written += count;
+        } while (res == HSER_POLL_MORE);
+        return res == HSER_POLL_EMPTY;
+    };
+
+    heatshrink_encoder_reset(&m_encoder);
+    for (std::size_t consumed = 0; consumed < in.size();) {
+        std::size_t count = 0;
+        if (heatshrink_encoder_sink(&m_encoder, bytes(in) + consumed, in.size() - consumed, &count) != HSER_SINK_OK)
+            return false;
+        consumed += count;
+        if (!drain())
+            return false;
+    }
+
+    for (;;) {
+        HSE_finish_res res = heatshrink_encoder_finish(&m_encoder);
+        if (res == HSER_FINISH_DONE)
+            break;
+        if (res != HSER_FINISH_MORE || !drain())
+            return false;
+    }
+
+    if (written >= in.size())
+        return false;
+    out.resize(written);
+    return true;
+}
+
+bool Codec::decompress(std::string_view in, std::string& out, std::size_t limit) {
+    if (!isCompressed(in))
+        return false;
+
+    std::uint32_t size = 0;
+    for (std::size_t i = 0; i < 4; ++i)
+        size |= static_cast<std::uint32_t>(static_cast<unsigned char>(in[s_magic.size() + i])) << (8 * i);
+    if (size > limit)
+        return false;
+    out.resize(size);
+
+    std::size_t written = 0;
+    auto drain = [&] {
+        HSD_poll_res res;
+        do {
+            std::size_t count = 0;
+            res = heatshrink_decoder_poll(&m_decoder, bytes(out) + written, out.size() - written, &count);
+            written += count;
+            // More output than announced.
+            if (res == HSDR_POLL_MORE && written == out.size())
+                return false;
+        } while (res == HSDR_POLL_MORE);
+        return res == HSDR_POLL_EMPTY;
+    };
+
+    heatshrink_decoder_reset(&m_decoder);
+    for (std::size_t consumed = s_headerSize; consumed < in.size();) {
+        std::size_t count = 0;
+        HSD_sink_res res = heatshrink_decoder_sink(&m_decoder, bytes(in) + consumed, in.size() - consumed, &count);
+        if (res != HSDR_SINK_OK && res != HSDR_SINK_FULL)
+            return false;
+        consumed += count;
+        if (!drain())
+            return false;
+    }
+
+    for (;;) {
+        HSD_finish_res res = heatshrink_decoder_finish(&m_decoder);
+        if (res == HSDR_FINISH_DONE)
+            break;
+        if (res != HSDR_FINISH_MORE || !drain())
+            return false;
+    }
+
+    return written == size;
+}
+
+} // namespace MQTT
@@ -0,0 +1,70 @@
+#include "Listeners.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace MQTT {
+
+void Listeners::publish(std::size_t slot, std::unique_ptr<const Snapshot> snapshot) {
+    m_snapshots[slot].store(snapshot.get());
+    if (m_owned[slot]) {
+        m_retired.push_back(std::move(m_owned[slot]));
+        m_retiredPending = true;
+    }
+    m_owned[slot] = std::move(snapshot);
+    reclaim();
+}
+
+void Listeners::reclaim() const {
+    // Snapshots retired so far are no longer published, only dispatches already running can hold them.
+    if (m_retired.empty() || m_readers.load() != 0)
+        return;
+    m_retired.clear();
+    m_retiredPending = false;
+}
+
+void Listeners::finishDispatch() const {
+    if (m_readers.fetch_sub(1) != 1 || !m_retiredPending.load())
+        return;
+    // A change in progress reclaims by itself, dispatch never waits for one.
+    std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+    if (lock)
+        reclaim();
+}
+
+Listeners::Handle Listeners::append(Event::Id id, Callback callback) {
+    std::size_t index = slot(id);
+    if (index >= s_slots)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Snapshot* current = m_owned[index].get();
+    auto snapshot = current ? std::make_unique<Snapshot>(*current) : std::make_unique<Snapshot>();
+    Handle handle = m_nextHandle++;
+    snapshot->push_back({ handle, callback });
+    publish(index, std::move(snapshot));
+    return handle;
+}
+
+bool Listeners::remove(Event::Id id, Handle handle) {
+    std::size_t index = slot(id);
+    if (index >= s_slots)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Snapshot* current = m_owned[index].get();
+    if (!current)
+        return false;
+
+    auto snapshot = std::make_unique<Snapshot>();
+    snapshot->reserve(current->size());
+    std::copy_if(current->begin(), current->end(), std::back_inserter(*snapshot), [handle](const Listener& listener) {
+        return listener.handle != handle;
+    });
+    if (snapshot->size() == current->size())
+        return false;
+    publish(index, std::move(snapshot));
+    return true;
+}
+
+} // namespace MQTT
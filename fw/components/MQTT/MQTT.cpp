@@ -3,14 +3,13 @@
 
 #include "magic_enum.hpp"
 
-#include "eventpp/eventdispatcher.h"
-
 #include "esp_crt_bundle.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_tls.h"
 #include "mqtt_client.h"
 
+#include <cstdint>
 #include <exception>
 #include <string>
 #include <string_view>
@@ -19,13 +18,48 @@
 namespace MQTT {
 
 void Client::trampoline(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data) {
-    ESP_LOGI(s_tag, "Received event: %s:%s", base, magic_enum::enum_name(static_cast<esp_mqtt_event_id_t>(event_id)).data());
+    // Compiled out unless CONFIG_LOG_MAXIMUM_LEVEL includes debug.
+    ESP_LOGD(s_tag, "Received event: %s:%s", base, magic_enum::enum_name(static_cast<esp_mqtt_event_id_t>(event_id)).data());
     auto client = static_cast<Client*>(handler_args);
-    client->m_dispatcher.dispatch(static_cast<Event::Id>(event_id), static_cast<esp_mqtt_event_handle_t>(event_data));
+    auto event = static_cast<esp_mqtt_event_handle_t>(event_data);
+    auto id = static_cast<Event::Id>(event_id);
+
+    if (id != Event::Id::Data) {
+        client->m_listeners.dispatch(id, event);
+        return;
+    }
+
+    // Listeners only ever see complete messages.
+    event = client->m_reassembler.feed(event);
+    if (!event)
+        return;
+    client->m_metrics.received(std::string_view(event->topic, event->topic_len), event->data_len);
+    if (!client->inflate(event)) {
+        client->m_reassembler.release();
+        return;
+    }
+    ESP_LOGV(s_tag, "Data on %.*s: %.*s", event->topic_len, event->topic, event->data_len, event->data);
+    client->m_listeners.dispatch(id, event);
+    client->m_router.dispatch(std::string_view(event->topic, event->topic_len), event);
+    client->m_reassembler.release();
 }
 
 Client::Client(const Config& config)
-    : m_config(esp_mqtt_client_config_t {}) {
+    : m_config(esp_mqtt_client_config_t {})
+    , m_reassembler(config.reassemblyBuffers, config.maxMessageSize)
+    , m_topics(config.version == Version::V5 ? config.topicAliases : 0, config.internedTopics)
+    , m_supervisor(config.reconnect)
+    , m_brokers([&] {
+        std::vector<std::string> uris = { config.host };
+        uris.insert(uris.end(), config.fallbackHosts.begin(), config.fallbackHosts.end());
+        return uris;
+    }(), config.probeTimeoutMs)
+    , m_version(config.version)
+    , m_asyncPublish(config.asyncPublish)
+    , m_maxMessageSize(config.maxMessageSize)
+    , m_compression(config.compression)
+    , m_metrics(config.metricsClassLevel)
+    , m_metricsIntervalMs(config.metricsIntervalMs) {
     ESP_LOGI(s_tag, "Initializing MQTT client");
     m_config.broker.address.uri = config.host.data();
 
@@ -55,6 +89,18 @@ Client::Client(const Config& config)
         break;
     }
 
+    if (config.clientCertificate && config.clientKey) {
+        m_config.credentials.authentication.certificate = config.clientCertificate->data();
+        m_config.credentials.authentication.key = config.clientKey->data();
+    }
+
+    bool secure = config.host.starts_with("mqtts://");
+    bool plain = config.host.starts_with("mqtt://");
+    if ((secure && config.resumeTlsSessions) || ((secure || plain) && config.coalescing.enabled())) {
+        m_transport.emplace(config, secure);
+        m_config.network.transport = m_transport->handle();
+    }
+
     if (config.will) {
         m_config.session.last_will.topic = config.will->topic.data();
         m_config.session.last_will.msg = config.will->data.data();
@@ -63,44 +109,84 @@ Client::Client(const Config& config)
         m_config.session.last_will.retain = config.will->retain;
     }
 
+    m_config.outbox.limit = config.outboxLimit;
+    m_config.session.protocol_ver = static_cast<esp_mqtt_protocol_ver_t>(config.version);
+
+    m_config.session.disable_clean_session = !config.cleanSession;
+    m_config.session.keepalive = config.keepalive;
+    // Reconnects are scheduled by the supervisor.
+    m_config.network.disable_auto_reconnect = true;
+
     m_client = esp_mqtt_client_init(&m_config);
     if (m_client == nullptr)
         throw std::runtime_error("Failed to initialize MQTT client");
+    m_supervisor.attach(m_client);
 
-    m_dispatcher.appendListener(Event::Id::Connected, [this](auto event) {
+    if (config.version == Version::V5 && !config.cleanSession) {
+        esp_mqtt5_connection_property_config_t property = {};
+        property.session_expiry_interval = config.sessionExpiry;
+        esp_mqtt5_client_set_connect_property(m_client, &property);
+    }
+
+    if (config.metricsTopic) {
+        m_metricsTopic = *config.metricsTopic;
+        const esp_timer_create_args_t args = {
+            .callback = publishMetrics,
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "mqtt_metrics",
+            .skip_unhandled_events = true,
+        };
+        if (esp_timer_create(&args, &m_metricsTimer) != ESP_OK)
+            throw std::runtime_error("Failed to create MQTT metrics timer");
+    }
+
+    m_listeners.append(Event::Id::Connected, [this](auto event) {
         ESP_LOGI(s_tag, "MQTT connected");
+        if (m_version == Version::V5)
+            m_topics.limitAliases(brokerAliasMaximum());
         m_connected = 1;
+        m_brokers.connected();
+        m_supervisor.connected(event->session_present);
     });
 
-    m_dispatcher.appendListener(Event::Id::Disconnected, [this](auto event) {
-        m_connected = 0;
+    m_listeners.append(Event::Id::Disconnected, [this](auto event) {
+        // Failed connection attempts are reported as disconnects too.
+        if (!m_connected.exchange(false))
+            m_brokers.failed();
+        m_reassembler.reset();
+        // Acknowledgements for the lost connection never arrive.
+        m_pending = 0;
+        // The broker forgets topic aliases with the connection.
+        m_topics.resetAliases();
         ESP_LOGI(s_tag, "MQTT disconnected");
+        m_supervisor.disconnected();
     });
 
-    m_dispatcher.appendListener(Event::Id::Subscribed, [this](auto event) {
-        ESP_LOGI(s_tag, "MQTT subscribed to %.*s", event->topic_len, event->topic);
+    // Runs in the esp-mqtt task right before it connects. Reconnects go to the best broker of the
+    // last background probe, a failed connection starts a new one, so a dead broker is replaced
+    // within about one backoff delay.
+    m_listeners.append(Event::Id::BeforeConnect, [this](auto event) {
+        if (m_supervisor.stats().attempts != 0 && m_brokers.size() > 1 && m_brokers.select())
+            esp_mqtt_client_set_uri(m_client, m_brokers.current().c_str());
     });
 
-    m_dispatcher.appendListener(Event::Id::Unsubscribed, [this](auto event) {
-        ESP_LOGI(s_tag, "MQTT unsubscribed from %.*s", event->topic_len, event->topic);
+    m_listeners.append(Event::Id::Subscribed, [this](auto event) {
+        ESP_LOGI(s_tag, "MQTT subscribed to %.*s", event->topic_len, event->topic);
     });
 
-    m_dispatcher.appendListener(Event::Id::Published, [this](auto event) {
-        ESP_LOGI(s_tag, "MQTT published to %.*s", event->topic_len, event->topic);
+    m_listeners.append(Event::Id::Unsubscribed, [this](auto event) {
+        ESP_LOGI(s_tag, "MQTT unsubscribed from %.*s", event->topic_len, event->topic);
     });
 
-    m_dispatcher.appendListener(Event::Id::Data, [this](auto event) {
-        ESP_LOGI(s_tag,
-            "MQTT data:\r\n"
-            "\tTOPIC = %.*s\r\n"
-            "\tDATA = %.*s\r\n",
-            event->topic_len,
-            event->topic,
-            event->data_len,
-            event->data);
+    m_listeners.append(Event::Id::Published, [this](auto event) {
+        std::uint32_t pending = m_pending.load();
+        while (pending != 0 && !m_pending.compare_exchange_weak(pending, pending - 1)) {}
+        m_metrics.acknowledged(event->msg_id);
+        ESP_LOGD(s_tag, "MQTT published message %d", event->msg_id);
     });
 
-    m_dispatcher.appendListener(Event::Id::Error, [this](auto event) {
+    m_listeners.append(Event::Id::Error, [this](auto event) {
         ESP_LOGI(s_tag, "MQTT error");
     });
 }
@@ -121,63 +207,293 @@ Client::Client(const std::string& host, const std::string& user, const std::stri
 }
 
 Client::~Client() {
+    m_supervisor.stop();
+    if (m_metricsTimer) {
+        esp_timer_stop(m_metricsTimer);
+        esp_timer_delete(m_metricsTimer);
+    }
     esp_mqtt_client_destroy(m_client);
 }
 
 void Client::subscribe(std::string_view topic, QOS qos) {
-    int ret = esp_mqtt_client_subscribe(m_client, topic.data(), static_cast<int>(qos));
+    const char* interned = m_topics.intern(topic);
+    int ret = esp_mqtt_client_subscribe(m_client, interned, static_cast<int>(qos));
     if (ret < 0)
-        ESP_LOGE(s_tag, "Error subscribing to topic: %s", topic.data());
-    ESP_LOGI(s_tag, "Subscribed to topic: %s", topic.data());
+        ESP_LOGE(s_tag, "Error subscribing to topic: %s", interned);
+    ESP_LOGI(s_tag, "Subscribed to topic: %s", interned);
 }
 
-Client::Handle Client::subscribe(std::string_view topic, Client::Callback callback, QOS qos) {
-    int ret = esp_mqtt_client_subscribe(m_client, topic.data(), static_cast<int>(qos));
+Client::Subscription Client::subscribe(std::string_view topic, Client::Callback callback, QOS qos) {
+    // Registered before subscribing, so retained messages sent right after SUBACK are not missed.
+    Subscription subscription = m_router.add(topic, callback);
+    if (subscription == TopicRouter::s_invalidHandle) {
+        ESP_LOGE(s_tag, "Invalid topic filter: %.*s", static_cast<int>(topic.size()), topic.data());
+        return subscription;
+    }
+
+    const char* interned = m_topics.intern(topic);
+    int ret = esp_mqtt_client_subscribe(m_client, interned, static_cast<int>(qos));
     if (ret < 0)
-        ESP_LOGE(s_tag, "Error subscribing to topic: %s", topic.data());
+        ESP_LOGE(s_tag, "Error subscribing to topic: %s", interned);
 
-    ESP_LOGI(s_tag, "Subscribed to topic: %s", topic.data());
-    return m_dispatcher.appendListener(Event::Id::Data, [=](esp_mqtt_event_handle_t event) {
-        std::string_view received_topic(event->topic, event->topic_len);
+    ESP_LOGI(s_tag, "Subscribed to topic: %s", interned);
+    return subscription;
+}
 
-        if (received_topic == topic) {
-            callback(event);
-        }
-    });
+bool Client::removeSubscription(Subscription subscription) {
+    return m_router.remove(subscription);
 }
 
 void Client::unsubscribe(std::string_view topic) {
-    int ret = esp_mqtt_client_unsubscribe(m_client, topic.data());
+    const char* interned = m_topics.intern(topic);
+    int ret = esp_mqtt_client_unsubscribe(m_client, interned);
     if (ret < 0)
-        ESP_LOGE(s_tag, "Error unsubscribing from topic: %s", topic.data());
+        ESP_LOGE(s_tag, "Error unsubscribing from topic: %s", interned);
 }
 
-void Client::publish(std::string_view topic, std::string_view message, QOS qos, bool retain) {
-    int ret = esp_mqtt_client_publish(m_client, topic.data(), message.data(), message.size(), static_cast<int>(qos), retain);
-    if (ret < 0)
-        ESP_LOGE(s_tag, "Error publishing message \"%s\" to topic: %s", message.data(), topic.data());
+bool Client::deflate(std::string_view message, std::string& out) {
+    if (m_compression.mode == CompressionMode::Off || message.size() < m_compression.threshold)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_encoderMutex);
+    if (!m_codec.compress(message, out))
+        return false;
+    ++m_compressed;
+    m_savedBytes += message.size() - out.size();
+    return true;
+}
+
+// Replaces the payload of a compressed message by the decompressed one, false if it is corrupt or too large.
+bool Client::inflate(Event::Data event) {
+    std::string_view payload(event->data, event->data_len);
+    if (m_compression.mode == CompressionMode::Off || !Codec::isCompressed(payload))
+        return true;
+
+    if (!m_codec.decompress(payload, m_inflated, m_maxMessageSize)) {
+        ++m_undecodable;
+        ESP_LOGW(s_tag, "Dropped undecodable compressed message on %.*s", event->topic_len, event->topic);
+        return false;
+    }
+    ++m_decompressed;
+    event->data = m_inflated.data();
+    event->data_len = static_cast<int>(m_inflated.size());
+    event->total_data_len = event->data_len;
+    return true;
+}
+
+bool Client::send(const char* topic, std::string_view message, QOS qos, bool retain, bool aliasOnly) {
+    int size = static_cast<int>(message.size());
+    // With an announced topic alias set in the publish properties, the topic itself is left empty.
+    const char* wireTopic = aliasOnly ? "" : topic;
+
+    // Enqueueing copies the message into the outbox and returns without touching the socket,
+    // the esp-mqtt task sends it. Blocking publish waits for the write and holds the client lock meanwhile.
+    int ret = m_asyncPublish
+        ? esp_mqtt_client_enqueue(m_client, wireTopic, message.data(), size, static_cast<int>(qos), retain, true)
+        : esp_mqtt_client_publish(m_client, wireTopic, message.data(), size, static_cast<int>(qos), retain);
+
+    if (ret == -2) {
+        ++m_rejected;
+        ESP_LOGW(s_tag, "Outbox full, dropped %d bytes to topic: %s", size, topic);
+        return false;
+    }
+    if (ret < 0) {
+        ESP_LOGE(s_tag, "Error publishing message \"%.*s\" to topic: %s", size, message.data(), topic);
+        return false;
+    }
+
+    if (qos != QOS::AtMostOnce)
+        ++m_pending;
+    m_metrics.sent(topic, message.size(), qos, ret);
+    return true;
+}
+
+// esp-mqtt keeps the topic alias maximum of the CONNACK to itself, but refuses publish properties
+// with a larger alias. Asks for the configured number first, so only a lower limit costs a search.
+std::uint16_t Client::brokerAliasMaximum() {
+    std::lock_guard<std::mutex> lock(m_propertyMutex);
+    esp_mqtt5_publish_property_config_t property = {};
+    auto accepts = [&](std::uint16_t alias) {
+        property.topic_alias = alias;
+        return esp_mqtt5_client_set_publish_property(m_client, &property) == ESP_OK;
+    };
+
+    std::uint16_t maximum = m_topics.maxAliases();
+    if (!accepts(maximum)) {
+        std::uint16_t low = 0;
+        std::uint16_t high = maximum - 1;
+        while (low < high) {
+            auto middle = static_cast<std::uint16_t>(low + (high - low + 1) / 2);
+            if (accepts(middle))
+                low = middle;
+            else
+                high = middle - 1;
+        }
+        maximum = low;
+    }
+    // The next publish must not inherit a probed alias.
+    accepts(0);
+    if (maximum < m_topics.maxAliases())
+        ESP_LOGW(s_tag, "Broker allows only %u topic aliases", static_cast<unsigned>(maximum));
+    return maximum;
+}
+
+bool Client::publish(std::string_view topic, std::string_view message, QOS qos, bool retain) {
+    return publish(topic, message, qos, retain, {});
+}
+
+bool Client::publish(std::string_view topic, std::string_view message, QOS qos, bool retain, const Properties& properties) {
+    std::string compressed;
+    if (deflate(message, compressed))
+        message = compressed;
+
+    // esp-mqtt wants a NUL-terminated topic, callers often pass a temporary.
+    if (m_version != Version::V5)
+        return send(m_topics.intern(topic), message, qos, retain);
+
+    // The broker knows an alias only on the connection it was set up on. QoS 1/2 messages may be
+    // retransmitted and queued publishes sent on a later connection, so only blocking QoS 0 publishes use one.
+    bool useAlias = qos == QOS::AtMostOnce && !m_asyncPublish && m_connected;
+    TopicTable::Entry entry = useAlias
+        ? m_topics.internWithAlias(topic)
+        : TopicTable::Entry { m_topics.intern(topic), 0, false };
+    // The topic is left out once the broker has seen it together with the alias.
+    bool aliasOnly = entry.alias != 0 && entry.announced;
+
+    esp_mqtt5_publish_property_config_t property = {};
+    property.topic_alias = entry.alias;
+    property.message_expiry_interval = properties.messageExpiry;
+
+    // Publish properties are client state applied to the next publish, so setting and publishing must not interleave.
+    std::lock_guard<std::mutex> lock(m_propertyMutex);
+    if (!properties.userProperties.empty()) {
+        // esp-mqtt copies the items and does not modify them.
+        auto items = const_cast<UserProperty*>(properties.userProperties.data());
+        if (esp_mqtt5_client_set_user_property(&property.user_property, items, static_cast<std::uint8_t>(properties.userProperties.size())) != ESP_OK) {
+            ESP_LOGE(s_tag, "Failed to set user properties for topic: %s", entry.topic);
+            return false;
+        }
+    }
+
+    bool sent = esp_mqtt5_client_set_publish_property(m_client, &property) == ESP_OK
+        && send(entry.topic, message, qos, retain, aliasOnly);
+    if (sent && !aliasOnly)
+        m_topics.announce(entry.alias);
+
+    // The publish packet is built by now, it keeps no reference to the list.
+    if (property.user_property)
+        esp_mqtt5_client_delete_user_property(property.user_property);
+    return sent;
+}
+
+bool Client::publish(const Message& message) {
+    return publish(message.topic, message.data, message.qos, message.retain);
 }
 
 void Client::stop() {
+    m_supervisor.stop();
+    if (m_metricsTimer)
+        esp_timer_stop(m_metricsTimer);
     ESP_ERROR_CHECK(esp_mqtt_client_stop(m_client));
 }
 
 void Client::start() {
     ESP_LOGI(s_tag, "Starting MQTT client");
+    if (m_brokers.size() > 1) {
+        // On the caller's task, later selections use probes refreshed in the background.
+        m_brokers.refresh();
+        if (m_brokers.select())
+            esp_mqtt_client_set_uri(m_client, m_brokers.current().c_str());
+    }
+    m_supervisor.start();
+    if (m_metricsTimer)
+        esp_timer_start_periodic(m_metricsTimer, static_cast<std::uint64_t>(m_metricsIntervalMs) * 1000);
     ESP_ERROR_CHECK(esp_mqtt_client_start(m_client));
     ESP_ERROR_CHECK(esp_mqtt_client_register_event(m_client, static_cast<esp_mqtt_event_id_t>(ESP_EVENT_ANY_ID), trampoline, this));
 }
 
 Client::Handle Client::on(Event::Id event, Callback callback) {
-    return m_dispatcher.appendListener(event, callback);
+    return m_listeners.append(event, callback);
 }
 
 void Client::removeListener(Event::Id event, Handle handle) {
-    m_dispatcher.removeListener(event, handle);
+    m_listeners.remove(event, handle);
 }
 
 bool Client::connected() const {
     return m_connected;
 }
 
+Reassembler::Stats Client::reassemblyStats() const {
+    return m_reassembler.stats();
+}
+
+Supervisor::Stats Client::connectionStats() const {
+    return m_supervisor.stats();
+}
+
+std::string Client::broker() const {
+    return m_brokers.current();
+}
+
+BrokerList::Stats Client::brokerStats() const {
+    return m_brokers.stats();
+}
+
+std::optional<SocketTransport::Stats> Client::transportStats() const {
+    if (!m_transport)
+        return std::nullopt;
+    return m_transport->stats();
+}
+
+CompressionStats Client::compressionStats() const {
+    return {
+        .compressed = m_compressed.load(),
+        .decompressed = m_decompressed.load(),
+        .savedBytes = m_savedBytes.load(),
+        .undecodable = m_undecodable.load(),
+    };
+}
+
+const Metrics& Client::metrics() const {
+    return m_metrics;
+}
+
+std::string Client::metricsReport() const {
+    OutboxStats outbox = outboxStats();
+    Supervisor::Stats connection = connectionStats();
+    Reassembler::Stats reassembly = reassemblyStats();
+
+    std::string report = "{";
+    m_metrics.appendJson(report);
+    report += ",\"outbox\":{\"bytes\":" + std::to_string(outbox.bytes)
+        + ",\"pending\":" + std::to_string(outbox.pending) + "}";
+    report += ",\"connection\":{\"reconnects\":" + std::to_string(connection.reconnects)
+        + ",\"lastOutageMs\":" + std::to_string(connection.lastOutageMs)
+        + ",\"maxOutageMs\":" + std::to_string(connection.maxOutageMs)
+        + ",\"failovers\":" + std::to_string(m_brokers.stats().failovers) + "}";
+    report += ",\"dropped\":{\"outboxFull\":" + std::to_string(outbox.rejected)
+        + ",\"oversized\":" + std::to_string(reassembly.oversized)
+        + ",\"noBuffer\":" + std::to_string(reassembly.exhausted)
+        + ",\"incomplete\":" + std::to_string(reassembly.incomplete)
+        + ",\"undecodable\":" + std::to_string(m_undecodable.load()) + "}";
+    report += '}';
+    return report;
+}
+
+void Client::publishMetrics(void* arg) {
+    auto client = static_cast<Client*>(arg);
+    if (client->connected())
+        client->publish(client->m_metricsTopic, client->metricsReport());
+}
+
+OutboxStats Client::outboxStats() const {
+    int bytes = esp_mqtt_client_get_outbox_size(m_client);
+    return {
+        .bytes = bytes > 0 ? static_cast<std::size_t>(bytes) : 0,
+        .pending = m_pending.load(),
+        .rejected = m_rejected.load(),
+    };
+}
+
 } // namespace MQTT
@@ -0,0 +1,175 @@
+#include "Metrics.hpp"
+
+#include "esp_timer.h"
+
+#include <algorithm>
+
+namespace MQTT {
+
+namespace {
+
+constexpr std::string_view s_other = "other";
+
+// Topic levels may contain anything but '/', '+' and '#', so class names are escaped.
+void appendString(std::string& out, std::string_view value) {
+    static constexpr char s_hex[] = "0123456789abcdef";
+    out += '"';
+    for (char c : value) {
+        auto byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (byte < 0x20) {
+            out += "\\u00";
+            out += s_hex[byte >> 4];
+            out += s_hex[byte & 0x0F];
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void appendMember(std::string& out, std::string_view name, std::uint64_t value) {
+    appendString(out, name);
+    out += ':';
+    out += std::to_string(value);
+}
+
+// Cuts a class name to `size` bytes without splitting a UTF-8 sequence.
+std::string_view truncate(std::string_view name, std::size_t size) {
+    if (name.size() <= size)
+        return name;
+    while (size > 0 && (static_cast<unsigned char>(name[size]) & 0xC0) == 0x80)
+        --size;
+    return name.substr(0, size);
+}
+
+} // namespace
+
+Metrics::Metrics(std::size_t classLevel)
+    : m_classLevel(classLevel) {
+    Slot& other = m_slots.back();
+    std::copy(s_other.begin(), s_other.end(), other.name.begin());
+    other.length = s_other.size();
+}
+
+std::string_view Metrics::classOf(std::string_view topic) const {
+    for (std::size_t level = 0; level < m_classLevel; ++level) {
+        auto separator = topic.find('/');
+        if (separator == std::string_view::npos)
+            return {};
+        topic.remove_prefix(separator + 1);
+    }
+    return topic.substr(0, topic.find('/'));
+}
+
+Metrics::Slot& Metrics::slot(std::string_view topic) {
+    std::string_view name = truncate(classOf(topic), s_nameSize);
+
+    // Slots are only ever appended, and published through m_used, so lookups need no lock.
+    std::size_t used = m_used.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < used; ++i)
+        if (m_slots[i].view() == name)
+            return m_slots[i];
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    used = m_used.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < used; ++i)
+        if (m_slots[i].view() == name)
+            return m_slots[i];
+    if (used == s_classes - 1)
+        return m_slots.back();
+
+    Slot& slot = m_slots[used];
+    std::copy(name.begin(), name.end(), slot.name.begin());
+    slot.length = name.size();
+    m_used.store(used + 1, std::memory_order_release);
+    return slot;
+}
+
+void Metrics::received(std::string_view topic, std::size_t bytes) {
+    slot(topic).in.add(bytes);
+}
+
+void Metrics::sent(std::string_view topic, std::size_t bytes, QOS qos, int id) {
+    slot(topic).out.add(bytes);
+    if (qos == QOS::AtMostOnce || id <= 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_inFlight[m_nextInFlight] = { id, esp_timer_get_time(), static_cast<std::uint8_t>(qos) };
+    m_nextInFlight = (m_nextInFlight + 1) % m_inFlight.size();
+}
+
+void Metrics::acknowledged(int id) {
+    std::int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_inFlight.begin(), m_inFlight.end(), [id](const InFlight& message) { return message.id == id; });
+    if (it == m_inFlight.end())
+        return;
+
+    auto elapsed = static_cast<std::uint32_t>(now - it->since);
+    LatencyCounters& latency = m_latency[it->qos];
+    ++latency.samples;
+    latency.totalUs += elapsed;
+    latency.maxUs = std::max(latency.maxUs, elapsed);
+    it->id = -1;
+}
+
+// Index s_classes - 1 is "other", the ones below classCount() are named classes.
+Metrics::Class Metrics::traffic(std::size_t index) const {
+    const Slot& slot = m_slots[std::min(index, s_classes - 1)];
+    return { slot.view(), slot.in.load(), slot.out.load() };
+}
+
+Metrics::Latency Metrics::latency(QOS qos) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const LatencyCounters& latency = m_latency[static_cast<std::size_t>(qos)];
+    return {
+        .samples = latency.samples,
+        .averageUs = latency.samples ? static_cast<std::uint32_t>(latency.totalUs / latency.samples) : 0,
+        .maxUs = latency.maxUs,
+    };
+}
+
+void Metrics::appendJson(std::string& out) const {
+    // The catch-all is kept out of "classes", where a topic class may have any name, "other" included.
+    auto appendCounters = [&](const Class& traffic) {
+        out += '{';
+        appendMember(out, "messagesIn", traffic.in.messages);
+        out += ',';
+        appendMember(out, "bytesIn", traffic.in.bytes);
+        out += ',';
+        appendMember(out, "messagesOut", traffic.out.messages);
+        out += ',';
+        appendMember(out, "bytesOut", traffic.out.bytes);
+        out += '}';
+    };
+    out += "\"classes\":{";
+    std::size_t count = classCount();
+    for (std::size_t i = 0; i < count; ++i) {
+        Class traffic = this->traffic(i);
+        if (i)
+            out += ',';
+        appendString(out, traffic.name);
+        out += ':';
+        appendCounters(traffic);
+    }
+    out += "},\"otherClasses\":";
+    appendCounters(traffic(s_classes - 1));
+    out += ",\"latency\":[";
+    for (std::size_t qos = 0; qos < m_latency.size(); ++qos) {
+        Latency value = latency(static_cast<QOS>(qos));
+        out += qos ? ",{" : "{";
+        appendMember(out, "samples", value.samples);
+        out += ',';
+        appendMember(out, "averageUs", value.averageUs);
+        out += ',';
+        appendMember(out, "maxUs", value.maxUs);
+        out += '}';
+    }
+    out += ']';
+}
+
+} // namespace MQTT
@@ -0,0 +1,129 @@
+#include "Reassembler.hpp"
+
+#include "esp_log.h"
+
+#include <cstring>
+#include <new>
+
+namespace MQTT {
+
+static constexpr const char* s_tag = "MQTT::Reassembler";
+
+Reassembler::Reassembler(std::size_t buffers, std::size_t capacity)
+    : m_capacity(capacity)
+    , m_pool(buffers) {}
+
+// Prefers a free buffer that is already large enough, else grows the first free one.
+Reassembler::Buffer* Reassembler::acquire(std::size_t size) {
+    Buffer* free = nullptr;
+    for (auto& buffer : m_pool) {
+        if (buffer.used)
+            continue;
+        if (buffer.size >= size) {
+            free = &buffer;
+            break;
+        }
+        if (!free)
+            free = &buffer;
+    }
+    if (!free)
+        return nullptr;
+
+    if (free->size < size) {
+        free->data.reset(new (std::nothrow) char[size]);
+        free->size = free->data ? size : 0;
+        if (!free->data)
+            return nullptr;
+    }
+    free->used = true;
+    return free;
+}
+
+void Reassembler::drop() {
+    if (!m_current)
+        return;
+    m_current->used = false;
+    m_current = nullptr;
+    ++m_incomplete;
+}
+
+Event::Data Reassembler::feed(Event::Data event) {
+    std::size_t offset = event->current_data_offset;
+    std::size_t length = event->data_len;
+    std::size_t total = event->total_data_len;
+
+    if (offset == 0 && length == total)
+        return event;
+
+    if (offset == 0) {
+        drop();
+
+        std::size_t topicLength = event->topic_len;
+        if (topicLength + total > m_capacity) {
+            ESP_LOGW(s_tag, "Dropping message of %u bytes, buffers hold %u", static_cast<unsigned>(topicLength + total), static_cast<unsigned>(m_capacity));
+            ++m_oversized;
+            return nullptr;
+        }
+
+        m_current = acquire(topicLength + total);
+        if (!m_current) {
+            ESP_LOGW(s_tag, "No buffer available, dropping message of %u bytes", static_cast<unsigned>(total));
+            ++m_exhausted;
+            return nullptr;
+        }
+
+        std::memcpy(m_current->data.get(), event->topic, topicLength);
+        m_current->topicLength = topicLength;
+        m_current->received = 0;
+        m_current->total = total;
+    }
+
+    // Chunks of an oversized or dropped message are skipped.
+    if (!m_current)
+        return nullptr;
+
+    if (offset != m_current->received || total != m_current->total || offset + length > total) {
+        drop();
+        return nullptr;
+    }
+
+    std::memcpy(m_current->data.get() + m_current->topicLength + offset, event->data, length);
+    m_current->received += length;
+    if (m_current->received < total)
+        return nullptr;
+
+    m_event = *event;
+    m_event.topic = m_current->data.get();
+    m_event.topic_len = m_current->topicLength;
+    m_event.data = m_current->data.get() + m_current->topicLength;
+    m_event.data_len = total;
+    m_event.current_data_offset = 0;
+
+    m_delivered = m_current;
+    m_current = nullptr;
+    ++m_reassembled;
+    return &m_event;
+}
+
+void Reassembler::release() {
+    if (m_delivered) {
+        m_delivered->used = false;
+        m_delivered = nullptr;
+    }
+}
+
+void Reassembler::reset() {
+    drop();
+    release();
+}
+
+Reassembler::Stats Reassembler::stats() const {
+    return {
+        .reassembled = m_reassembled.load(std::memory_order_relaxed),
+        .oversized = m_oversized.load(std::memory_order_relaxed),
+        .exhausted = m_exhausted.load(std::memory_order_relaxed),
+        .incomplete = m_incomplete.load(std::memory_order_relaxed),
+    };
+}
+
+} // namespace MQTT
@@ -0,0 +1,318 @@
+#include "SocketTransport.hpp"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <sys/select.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace MQTT {
+
+namespace {
+
+// mbedTLS parses PEM only with the terminating NUL counted, DER must be passed as is.
+std::size_t certificateBytes(const std::string& certificate) {
+    bool pem = certificate.find("-----BEGIN ") != std::string::npos;
+    return pem ? certificate.size() + 1 : certificate.size();
+}
+
+} // namespace
+
+SocketTransport::SocketTransport(const Config& config, bool secure)
+    : m_secure(secure)
+    , m_coalescing(config.coalescing) {
+    if (secure && config.resumeTlsSessions)
+        m_sessions.emplace(config.tlsSessionNamespace);
+    m_config.is_plain_tcp = !secure;
+    switch (config.serverCertificate.index()) {
+    case 1:
+        m_serverCertificate = std::get<1>(config.serverCertificate);
+        m_config.cacert_buf = reinterpret_cast<const unsigned char*>(m_serverCertificate.c_str());
+        m_config.cacert_bytes = certificateBytes(m_serverCertificate);
+        break;
+    case 2:
+        m_config.crt_bundle_attach = std::get<2>(config.serverCertificate);
+        break;
+    case 3:
+        m_config.use_global_ca_store = true;
+        break;
+    default:
+        break;
+    }
+
+    if (config.clientCertificate && config.clientKey) {
+        m_clientCertificate = *config.clientCertificate;
+        m_clientKey = *config.clientKey;
+        m_config.clientcert_buf = reinterpret_cast<const unsigned char*>(m_clientCertificate.c_str());
+        m_config.clientcert_bytes = certificateBytes(m_clientCertificate);
+        m_config.clientkey_buf = reinterpret_cast<const unsigned char*>(m_clientKey.c_str());
+        m_config.clientkey_bytes = certificateBytes(m_clientKey);
+    }
+
+    m_transport = esp_transport_init();
+    if (m_transport == nullptr)
+        throw std::runtime_error("Failed to create MQTT transport");
+    esp_transport_set_func(m_transport, connect, read, write, close, pollRead, pollWrite, destroy);
+    esp_transport_set_context_data(m_transport, this);
+    esp_transport_set_default_port(m_transport, secure ? 8883 : 1883);
+}
+
+SocketTransport::~SocketTransport() {
+    // Only still set if the handle was never handed over to esp-mqtt.
+    if (m_transport)
+        esp_transport_destroy(m_transport);
+    disconnect();
+}
+
+SocketTransport& SocketTransport::self(esp_transport_handle_t transport) {
+    return *static_cast<SocketTransport*>(esp_transport_get_context_data(transport));
+}
+
+int SocketTransport::connect(esp_transport_handle_t transport, const char* host, int port, int timeoutMs) {
+    SocketTransport& state = self(transport);
+    state.disconnect();
+
+    state.m_host = host;
+    bool resuming = false;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (state.m_sessions) {
+        state.m_config.client_session = state.m_sessions->session(state.m_host);
+        resuming = state.m_config.client_session != nullptr;
+    }
+#endif
+    state.m_config.timeout_ms = timeoutMs;
+
+    state.m_tls = esp_tls_init();
+    if (state.m_tls == nullptr)
+        return -1;
+
+    std::int64_t start = esp_timer_get_time();
+    if (esp_tls_conn_new_sync(host, std::strlen(host), port, &state.m_config, state.m_tls) <= 0) {
+        ESP_LOGE(s_tag, "Connection to %s:%d failed", host, port);
+        ++state.m_failures;
+        esp_tls_conn_destroy(state.m_tls);
+        state.m_tls = nullptr;
+        return -1;
+    }
+
+    if (state.m_secure) {
+        auto elapsed = static_cast<std::uint32_t>((esp_timer_get_time() - start) / 1000);
+        ++state.m_handshakes;
+        if (resuming) {
+            ++state.m_resumptions;
+            state.m_lastResumedMs = elapsed;
+        } else {
+            state.m_lastFullMs = elapsed;
+        }
+        ESP_LOGI(s_tag, "%s handshake with %s took %lu ms", resuming ? "Resumed" : "Full", host, static_cast<unsigned long>(elapsed));
+    }
+
+    state.saveSession();
+    return 0;
+}
+
+int SocketTransport::read(esp_transport_handle_t transport, char* buffer, int length, int timeoutMs) {
+    SocketTransport& state = self(transport);
+    if (!state.m_tls)
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+
+    int ready = state.waitReadable(timeoutMs);
+    if (ready == 0)
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    if (ready < 0)
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+
+    ssize_t ret = esp_tls_conn_read(state.m_tls, buffer, length);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_TIMEOUT)
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    if (ret == 0)
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    return static_cast<int>(ret);
+}
+
+int SocketTransport::write(esp_transport_handle_t transport, const char* buffer, int length, int timeoutMs) {
+    SocketTransport& state = self(transport);
+    if (!state.m_tls)
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+
+    std::lock_guard<std::mutex> lock(state.m_heldMutex);
+    if (state.hold(buffer, length)) {
+        if (state.m_held.size() >= state.m_coalescing.maxBytes && !state.flush(timeoutMs))
+            return -1;
+        return length;
+    }
+
+    // Held packets go first to keep the order.
+    if (!state.flush(timeoutMs))
+        return -1;
+    return state.writeAll(buffer, length, timeoutMs);
+}
+
+int SocketTransport::pollRead(esp_transport_handle_t transport, int timeoutMs) {
+    return self(transport).waitReadable(timeoutMs);
+}
+
+int SocketTransport::pollWrite(esp_transport_handle_t transport, int timeoutMs) {
+    return self(transport).poll(timeoutMs, false);
+}
+
+int SocketTransport::close(esp_transport_handle_t transport) {
+    self(transport).disconnect();
+    return 0;
+}
+
+int SocketTransport::destroy(esp_transport_handle_t transport) {
+    SocketTransport& state = self(transport);
+    state.disconnect();
+    state.m_transport = nullptr;
+    return 0;
+}
+
+int SocketTransport::poll(int timeoutMs, bool read) const {
+    int fd = -1;
+    if (!m_tls || esp_tls_get_conn_sockfd(m_tls, &fd) != ESP_OK || fd < 0)
+        return -1;
+
+    fd_set ready;
+    fd_set errors;
+    FD_ZERO(&ready);
+    FD_ZERO(&errors);
+    FD_SET(fd, &ready);
+    FD_SET(fd, &errors);
+
+    timeval timeout = {
+        .tv_sec = timeoutMs / 1000,
+        .tv_usec = (timeoutMs % 1000) * 1000,
+    };
+    int ret = select(fd + 1, read ? &ready : nullptr, read ? nullptr : &ready, &errors, timeoutMs < 0 ? nullptr : &timeout);
+    if (ret > 0 && FD_ISSET(fd, &errors))
+        return -1;
+    return ret;
+}
+
+int SocketTransport::writeAll(const char* buffer, int length, int timeoutMs) {
+    int written = 0;
+    while (written < length) {
+        int ready = poll(timeoutMs, false);
+        if (ready <= 0)
+            return ready;
+        ssize_t ret = esp_tls_conn_write(m_tls, buffer + written, length - written);
+        if (ret == ESP_TLS_ERR_SSL_WANT_WRITE)
+            continue;
+        if (ret < 0)
+            return static_cast<int>(ret);
+        written += static_cast<int>(ret);
+    }
+    return written;
+}
+
+// Holds complete PUBLISH packets whose QoS has a hold time, if they fit.
+bool SocketTransport::hold(const char* buffer, int length) {
+    if (length < 2 || (static_cast<std::uint8_t>(buffer[0]) & 0xF0) != 0x30)
+        return false;
+    unsigned qos = (static_cast<std::uint8_t>(buffer[0]) >> 1) & 0x03;
+    if (qos >= m_coalescing.holdUs.size() || m_coalescing.holdUs[qos] == 0)
+        return false;
+    if (m_held.size() + length > m_coalescing.maxBytes)
+        return false;
+
+    // esp-mqtt writes large messages in several chunks, those are not held.
+    std::size_t remaining = 0;
+    int header = 1;
+    for (int shift = 0; header < length && header <= 4; shift += 7) {
+        auto byte = static_cast<std::uint8_t>(buffer[header++]);
+        remaining |= static_cast<std::size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+    }
+    if (header + remaining != static_cast<std::size_t>(length))
+        return false;
+
+    std::int64_t deadline = esp_timer_get_time() + m_coalescing.holdUs[qos];
+    if (m_held.empty() || deadline < m_deadline)
+        m_deadline = deadline;
+    m_held.append(buffer, length);
+    ++m_coalesced;
+    return true;
+}
+
+bool SocketTransport::flush(int timeoutMs) {
+    if (m_held.empty())
+        return true;
+    int size = static_cast<int>(m_held.size());
+    bool written = writeAll(m_held.data(), size, timeoutMs) == size;
+    ++m_flushes;
+    m_held.clear();
+    if (!written) {
+        ESP_LOGE(s_tag, "Failed to write %d held bytes", size);
+        m_failed = true;
+    }
+    return written;
+}
+
+// Waits for incoming data, flushing held packets when their time is up.
+int SocketTransport::waitReadable(int timeoutMs) {
+    for (bool first = true;; first = false) {
+        int wait = timeoutMs;
+        {
+            std::lock_guard<std::mutex> lock(m_heldMutex);
+            if (m_failed)
+                return -1;
+            if (first && m_tls && esp_tls_get_bytes_avail(m_tls) > 0)
+                return 1;
+
+            if (!m_held.empty()) {
+                auto remaining = static_cast<int>((m_deadline - esp_timer_get_time() + 999) / 1000);
+                if (remaining <= 0) {
+                    if (!flush(timeoutMs))
+                        return -1;
+                    continue;
+                }
+                wait = timeoutMs < 0 ? remaining : std::min(timeoutMs, remaining);
+            }
+        }
+
+        // Polled without the lock, so publishes are not held up by a long wait.
+        int ret = poll(wait, true);
+        if (ret != 0 || wait == timeoutMs)
+            return ret;
+        if (timeoutMs > 0)
+            timeoutMs -= wait;
+    }
+}
+
+void SocketTransport::saveSession() {
+    if (m_tls && m_sessions)
+        m_sessions->save(m_tls, m_host);
+}
+
+// Held packets are dropped, QoS 1 and 2 messages are resent on the next connection.
+void SocketTransport::disconnect() {
+    {
+        std::lock_guard<std::mutex> lock(m_heldMutex);
+        m_held.clear();
+        m_failed = false;
+    }
+    if (!m_tls)
+        return;
+    saveSession();
+    esp_tls_conn_destroy(m_tls);
+    m_tls = nullptr;
+}
+
+SocketTransport::Stats SocketTransport::stats() const {
+    return {
+        .handshakes = m_handshakes.load(),
+        .resumptions = m_resumptions.load(),
+        .failures = m_failures.load(),
+        .lastFullMs = m_lastFullMs.load(),
+        .lastResumedMs = m_lastResumedMs.load(),
+        .coalesced = m_coalesced.load(),
+        .flushes = m_flushes.load(),
+    };
+}
+
+} // namespace MQTT
@@ -0,0 +1,98 @@
+#include "Supervisor.hpp"
+
+#include "esp_log.h"
+#include "esp_random.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace MQTT {
+
+Supervisor::Supervisor(const Backoff& backoff)
+    : m_backoff(backoff) {
+    const esp_timer_create_args_t args = {
+        .callback = onTimer,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "mqtt_reconnect",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&args, &m_timer) != ESP_OK)
+        throw std::runtime_error("Failed to create MQTT reconnect timer");
+}
+
+Supervisor::~Supervisor() {
+    esp_timer_stop(m_timer);
+    esp_timer_delete(m_timer);
+}
+
+void Supervisor::attach(esp_mqtt_client_handle_t client) {
+    m_client = client;
+}
+
+void Supervisor::start() {
+    m_attempt = 0;
+    m_running = true;
+}
+
+void Supervisor::stop() {
+    m_running = false;
+    esp_timer_stop(m_timer);
+}
+
+void Supervisor::onTimer(void* arg) {
+    auto supervisor = static_cast<Supervisor*>(arg);
+    if (!supervisor->m_running)
+        return;
+    ESP_LOGI(s_tag, "Reconnect attempt %lu", static_cast<unsigned long>(supervisor->m_attempt.load()));
+    if (esp_mqtt_client_reconnect(supervisor->m_client) != ESP_OK)
+        supervisor->disconnected();
+}
+
+void Supervisor::connected(bool sessionPresent) {
+    m_sessionPresent = sessionPresent;
+    if (m_attempt != 0) {
+        auto outage = static_cast<std::uint32_t>((esp_timer_get_time() - m_disconnectedAt) / 1000);
+        m_lastOutageMs = outage;
+        m_maxOutageMs = std::max(m_maxOutageMs.load(), outage);
+        ++m_reconnects;
+        ESP_LOGI(s_tag, "Reconnected after %lu ms and %lu attempts, session %s",
+            static_cast<unsigned long>(outage), static_cast<unsigned long>(m_attempt.load()), sessionPresent ? "kept" : "lost");
+    }
+    m_attempt = 0;
+}
+
+// Also reported for every failed connection attempt, which advances the backoff.
+void Supervisor::disconnected() {
+    if (!m_running)
+        return;
+    if (m_attempt == 0)
+        m_disconnectedAt = esp_timer_get_time();
+
+    std::uint32_t delay = delayMs(m_attempt++);
+    ESP_LOGI(s_tag, "Reconnecting in %lu ms", static_cast<unsigned long>(delay));
+    esp_timer_stop(m_timer);
+    esp_timer_start_once(m_timer, static_cast<std::uint64_t>(delay) * 1000);
+}
+
+std::uint32_t Supervisor::delayMs(std::uint32_t attempt) const {
+    std::uint64_t ceiling = m_backoff.initialMs;
+    for (std::uint32_t i = 0; i < attempt && ceiling < m_backoff.maxMs; ++i)
+        ceiling *= 2;
+    ceiling = std::min<std::uint64_t>(ceiling, m_backoff.maxMs);
+
+    std::uint64_t half = ceiling / 2;
+    return static_cast<std::uint32_t>(half + esp_random() % (ceiling - half + 1));
+}
+
+Supervisor::Stats Supervisor::stats() const {
+    return {
+        .reconnects = m_reconnects.load(),
+        .attempts = m_attempt.load(),
+        .lastOutageMs = m_lastOutageMs.load(),
+        .maxOutageMs = m_maxOutageMs.load(),
+        .sessionPresent = m_sessionPresent.load(),
+    };
+}
+
+} // namespace MQTT
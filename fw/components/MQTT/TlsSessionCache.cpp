@@ -0,0 +1,117 @@
+#include "TlsSessionCache.hpp"
+
+#include "NVS.hpp"
+
+#include "esp_log.h"
+
+#if defined(CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS) && defined(CONFIG_ESP_TLS_USING_MBEDTLS)
+#include "mbedtls/ssl.h"
+
+#include <cstdlib>
+#endif
+
+#include <exception>
+
+namespace MQTT {
+
+namespace {
+
+#if defined(CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS) && defined(CONFIG_ESP_TLS_USING_MBEDTLS)
+// esp-tls keeps nothing but the mbedTLS session in its client session and frees it with free(),
+// so a session loaded here can be handed to esp-tls like one it made itself.
+mbedtls_ssl_session* mbedtlsSession(esp_tls_client_session_t* session) {
+    return reinterpret_cast<mbedtls_ssl_session*>(session);
+}
+#endif
+
+} // namespace
+
+TlsSessionCache::TlsSessionCache(std::string nvsNamespace)
+    : m_namespace(std::move(nvsNamespace)) {
+    if (!m_namespace.empty())
+        load();
+}
+
+TlsSessionCache::~TlsSessionCache() {
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (m_session)
+        esp_tls_free_client_session(m_session);
+#endif
+}
+
+esp_tls_client_session_t* TlsSessionCache::session(const std::string& host) const {
+    return host == m_host ? m_session : nullptr;
+}
+
+// TLS 1.3 tickets arrive after the handshake, so this is also called when the connection closes.
+void TlsSessionCache::save(esp_tls_t* tls, const std::string& host) {
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    esp_tls_client_session_t* session = esp_tls_get_client_session(tls);
+    if (!session)
+        return;
+    if (m_session)
+        esp_tls_free_client_session(m_session);
+    m_session = session;
+    m_host = host;
+    if (!m_namespace.empty())
+        store();
+#endif
+}
+
+void TlsSessionCache::load() {
+#if defined(CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS) && defined(CONFIG_ESP_TLS_USING_MBEDTLS)
+    Blob data;
+    std::string host;
+    try {
+        NVS nvs(m_namespace);
+        if (!nvs.contains("session") || !nvs.contains("host"))
+            return;
+        data = std::get<Blob>(nvs.get("session"));
+        host = std::get<std::string>(nvs.get("host"));
+    } catch (const std::exception& e) {
+        ESP_LOGW(s_tag, "Failed to load the TLS session: %s", e.what());
+        return;
+    }
+
+    auto* session = static_cast<esp_tls_client_session_t*>(std::calloc(1, sizeof(mbedtls_ssl_session)));
+    if (!session)
+        return;
+    mbedtls_ssl_session_init(mbedtlsSession(session));
+    if (mbedtls_ssl_session_load(mbedtlsSession(session), data.data(), data.size()) != 0) {
+        // Stored by another mbedTLS version or configuration.
+        ESP_LOGW(s_tag, "Discarding the stored TLS session");
+        esp_tls_free_client_session(session);
+        return;
+    }
+    m_session = session;
+    m_host = std::move(host);
+    m_stored = std::move(data);
+    ESP_LOGI(s_tag, "Loaded the TLS session for %s", m_host.c_str());
+#else
+    ESP_LOGW(s_tag, "TLS sessions are only persisted with mbedTLS and CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS");
+#endif
+}
+
+// Brokers issue a new ticket per handshake, so this writes to flash about once per connection.
+void TlsSessionCache::store() {
+#if defined(CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS) && defined(CONFIG_ESP_TLS_USING_MBEDTLS)
+    std::size_t length = 0;
+    mbedtls_ssl_session_save(mbedtlsSession(m_session), nullptr, 0, &length);
+    Blob data(length);
+    if (length == 0 || mbedtls_ssl_session_save(mbedtlsSession(m_session), data.data(), data.size(), &length) != 0)
+        return;
+    if (data == m_stored)
+        return;
+    try {
+        NVS nvs(m_namespace);
+        nvs.set("session", data);
+        nvs.set("host", m_host);
+        nvs.commit();
+        m_stored = std::move(data);
+    } catch (const std::exception& e) {
+        ESP_LOGW(s_tag, "Failed to store the TLS session: %s", e.what());
+    }
+#endif
+}
+
+} // namespace MQTT
@@ -0,0 +1,198 @@
+#include "TopicRouter.hpp"
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+
+namespace MQTT {
+
+namespace {
+
+// Splits the first level off `rest`, `end` is set once the last level was taken.
+std::string_view takeLevel(std::string_view& rest, bool& end) {
+    auto separator = rest.find('/');
+    std::string_view level = rest.substr(0, separator);
+    if (separator == std::string_view::npos) {
+        rest = {};
+        end = true;
+    } else {
+        rest.remove_prefix(separator + 1);
+    }
+    return level;
+}
+
+} // namespace
+
+bool TopicRouter::isValidFilter(std::string_view filter) {
+    if (filter.empty())
+        return false;
+
+    bool end = false;
+    while (!end) {
+        std::string_view level = takeLevel(filter, end);
+        if (level == "#")
+            return end;
+        if (level.find_first_of("#+") != std::string_view::npos && level != "+")
+            return false;
+    }
+    return true;
+}
+
+std::unique_ptr<TopicRouter::Node> TopicRouter::copy(const Node& node) {
+    auto result = std::make_unique<Node>();
+    result->exact = node.exact;
+    result->multiLevel = node.multiLevel;
+    if (node.singleLevel)
+        result->singleLevel = copy(*node.singleLevel);
+    for (const auto& [level, child] : node.children) {
+        if (auto copied = copy(*child))
+            result->children.emplace(level, std::move(copied));
+    }
+    bool empty = result->exact.empty() && result->multiLevel.empty() && !result->singleLevel && result->children.empty();
+    return empty ? nullptr : std::move(result);
+}
+
+void TopicRouter::publish(std::unique_ptr<const Node> snapshot) {
+    m_snapshot.store(snapshot.get());
+    if (m_owned) {
+        m_retired.push_back(std::move(m_owned));
+        m_retiredPending = true;
+    }
+    m_owned = std::move(snapshot);
+    reclaim();
+}
+
+void TopicRouter::reclaim() const {
+    // Snapshots retired so far are no longer published, only dispatches already running can hold them.
+    if (m_retired.empty() || m_readers.load() != 0)
+        return;
+    m_retired.clear();
+    m_retiredPending = false;
+}
+
+void TopicRouter::finishDispatch() const {
+    if (m_readers.fetch_sub(1) != 1 || !m_retiredPending.load())
+        return;
+    // A change in progress reclaims by itself, dispatch never waits for one.
+    std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+    if (lock)
+        reclaim();
+}
+
+TopicRouter::Handle TopicRouter::add(std::string_view filter, Callback callback) {
+    if (!isValidFilter(filter))
+        return s_invalidHandle;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Handle handle = m_nextHandle++;
+    if (m_nextHandle == s_invalidHandle)
+        ++m_nextHandle;
+
+    std::unique_ptr<Node> root = m_owned ? copy(*m_owned) : nullptr;
+    if (!root)
+        root = std::make_unique<Node>();
+    Node* node = root.get();
+    bool end = false;
+    while (!end) {
+        std::string_view level = takeLevel(filter, end);
+        if (level == "#") {
+            node->multiLevel.push_back({ handle, callback });
+            ++m_size;
+            publish(std::move(root));
+            return handle;
+        }
+
+        std::unique_ptr<Node>* next = nullptr;
+        if (level == "+") {
+            next = &node->singleLevel;
+        } else {
+            auto it = node->children.find(level);
+            if (it == node->children.end())
+                it = node->children.emplace(std::string(level), nullptr).first;
+            next = &it->second;
+        }
+        if (!*next)
+            *next = std::make_unique<Node>();
+        node = next->get();
+    }
+
+    node->exact.push_back({ handle, callback });
+    ++m_size;
+    publish(std::move(root));
+    return handle;
+}
+
+bool TopicRouter::remove(std::vector<Subscription>& subscriptions, Handle handle) {
+    auto it = std::find_if(subscriptions.begin(), subscriptions.end(), [handle](const Subscription& subscription) {
+        return subscription.handle == handle;
+    });
+    if (it == subscriptions.end())
+        return false;
+    subscriptions.erase(it);
+    return true;
+}
+
+bool TopicRouter::remove(Node& node, Handle handle) {
+    if (remove(node.exact, handle) || remove(node.multiLevel, handle))
+        return true;
+    if (node.singleLevel && remove(*node.singleLevel, handle))
+        return true;
+    for (auto& [level, child] : node.children) {
+        if (remove(*child, handle))
+            return true;
+    }
+    return false;
+}
+
+bool TopicRouter::remove(Handle handle) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_owned)
+        return false;
+    // Copied twice, so the nodes left empty by the removal are not kept.
+    std::unique_ptr<Node> root = copy(*m_owned);
+    if (!root || !remove(*root, handle))
+        return false;
+    publish(copy(*root));
+    --m_size;
+    return true;
+}
+
+std::size_t TopicRouter::invoke(const std::vector<Subscription>& subscriptions, Event::Data event) {
+    for (const Subscription& subscription : subscriptions)
+        subscription.callback(event);
+    return subscriptions.size();
+}
+
+std::size_t TopicRouter::dispatch(const Node& node, std::string_view rest, bool end, bool root, Event::Data event) {
+    // Topics starting with "$" are reserved for the broker and do not match wildcards at the first level.
+    bool wildcards = !root || rest.empty() || rest.front() != '$';
+
+    // "a/#" also matches "a", so multi-level subscriptions fire before the end check.
+    std::size_t count = wildcards ? invoke(node.multiLevel, event) : 0;
+    if (end)
+        return count + invoke(node.exact, event);
+
+    std::string_view level = takeLevel(rest, end);
+    auto child = node.children.find(level);
+    if (child != node.children.end())
+        count += dispatch(*child->second, rest, end, false, event);
+    if (wildcards && node.singleLevel)
+        count += dispatch(*node.singleLevel, rest, end, false, event);
+    return count;
+}
+
+std::size_t TopicRouter::dispatch(std::string_view topic, Event::Data event) const {
+    // Sequentially consistent, so a change that sees no readers also knows none can still load the old snapshot.
+    m_readers.fetch_add(1);
+    const Node* root = m_snapshot.load();
+    std::size_t count = root ? dispatch(*root, topic, false, true, event) : 0;
+    finishDispatch();
+    return count;
+}
+
+std::size_t TopicRouter::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+} // namespace MQTT
@@ -0,0 +1,72 @@
+#include "TopicTable.hpp"
+
+#include <algorithm>
+
+namespace MQTT {
+
+namespace {
+
+// Reused by every call of a thread, so overflowing topics cost no allocation once it is large enough.
+const char* scratch(std::string_view topic) {
+    thread_local std::string buffer;
+    buffer.assign(topic);
+    return buffer.c_str();
+}
+
+} // namespace
+
+const char* TopicTable::intern(std::string_view topic) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_topics.find(topic);
+    if (it == m_topics.end()) {
+        if (m_topics.size() >= m_capacity)
+            return scratch(topic);
+        it = m_topics.emplace(topic, Alias {}).first;
+    }
+    return it->first.c_str();
+}
+
+TopicTable::Entry TopicTable::internWithAlias(std::string_view topic) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_topics.find(topic);
+    if (it == m_topics.end()) {
+        if (m_topics.size() >= m_capacity)
+            return { scratch(topic), 0, false };
+        it = m_topics.emplace(topic, Alias {}).first;
+    }
+    Alias& alias = it->second;
+    if (alias.id == 0 && m_nextAlias <= m_aliases)
+        alias.id = m_nextAlias++;
+    return { it->first.c_str(), alias.id, alias.announced };
+}
+
+void TopicTable::announce(std::uint16_t alias) {
+    if (alias == 0)
+        return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [topic, entry] : m_topics) {
+        if (entry.id == alias) {
+            entry.announced = true;
+            return;
+        }
+    }
+}
+
+void TopicTable::resetAliases() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [topic, entry] : m_topics)
+        entry = Alias {};
+    m_nextAlias = 1;
+}
+
+void TopicTable::limitAliases(std::uint16_t maximum) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_aliases = std::min(m_maxAliases, maximum);
+}
+
+std::size_t TopicTable::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_topics.size();
+}
+
+} // namespace MQTT
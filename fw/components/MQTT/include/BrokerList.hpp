@@ -0,0 +1,109 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace MQTT {
+
+/**
+ * Candidate brokers of a client and the one it currently connects to.
+ *
+ * Candidates are probed concurrently with a plain TCP connect to their host
+ * and port, which is timed as the round trip. The selected broker is the
+ * reachable one with the fewest failed connections since it last worked,
+ * then the lowest round trip, then the earliest in the list. A broker that
+ * accepts TCP but refuses the MQTT connection is so demoted after a failure.
+ *
+ * select() never probes, it only ranks the results of the last refresh, so
+ * it is cheap enough for the esp-mqtt task. refresh() resolves and probes all
+ * candidates and blocks, it is meant for the first selection. Every select()
+ * and failed connection then refreshes on a background thread for the next
+ * selection, keeping the last known address of a host that fails to resolve.
+ *
+ * All candidates should use the scheme of the first one, the transport is
+ * chosen by the client only once.
+ */
+class BrokerList {
+public:
+    struct Endpoint {
+        std::string host;
+        std::uint16_t port;
+    };
+
+    struct Candidate {
+        std::string uri;
+        std::optional<Endpoint> endpoint; // Empty if the URI could not be parsed.
+        std::optional<std::uint32_t> rttMs; // Empty if unreachable at the last probe.
+        std::uint32_t failures = 0; // Failed connections since the last successful one.
+    };
+
+    struct Stats {
+        std::uint32_t probes;
+        std::uint32_t failovers; // Selections of a different broker than the current one.
+        std::uint32_t lastProbeMs; // Duration of the last probe.
+    };
+
+private:
+    static constexpr const char* s_tag = "MQTT::BrokerList";
+
+    struct Address {
+        sockaddr_storage storage;
+        socklen_t length;
+        int family;
+    };
+
+    const std::uint32_t m_probeTimeoutMs;
+
+    mutable std::mutex m_mutex;
+    std::vector<Candidate> m_candidates;
+    std::vector<std::optional<Address>> m_addresses; // Of the candidates, in the same order.
+    std::size_t m_current = 0;
+
+    std::mutex m_refresherMutex;
+    std::condition_variable m_refresherWake;
+    bool m_refreshRequested = false;
+    bool m_stopping = false;
+    std::thread m_refresher;
+
+    std::atomic<std::uint32_t> m_probes = 0;
+    std::atomic<std::uint32_t> m_failovers = 0;
+    std::atomic<std::uint32_t> m_lastProbeMs = 0;
+
+    void resolve();
+    void probe();
+    void requestRefresh();
+    void refresherLoop();
+
+public:
+    BrokerList(const std::vector<std::string>& uris, std::uint32_t probeTimeoutMs);
+    ~BrokerList();
+
+    BrokerList(const BrokerList&) = delete;
+    BrokerList& operator=(const BrokerList&) = delete;
+
+    static std::optional<Endpoint> parse(std::string_view uri);
+
+    // Resolves and probes all candidates, blocks for as long as DNS takes plus up to the probe timeout.
+    void refresh();
+    // Switches to the best reachable candidate of the last refresh, returns true if that is a different one.
+    // Candidates that were never probed count as unreachable.
+    bool select();
+    void connected();
+    void failed();
+
+    std::size_t size() const;
+    std::string current() const;
+    std::vector<Candidate> candidates() const;
+    Stats stats() const;
+};
+
+} // namespace MQTT
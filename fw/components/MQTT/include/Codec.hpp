@@ -0,0 +1,43 @@
+#pragma once
+
+extern "C" {
+#include "heatshrink_decoder.h"
+#include "heatshrink_encoder.h"
+}
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace MQTT {
+
+/**
+ * heatshrink compression of message payloads.
+ *
+ * A compressed payload is s_magic, the uncompressed size as 32-bit little
+ * endian and the heatshrink stream. The magic starts with a NUL byte, which
+ * no JSON or text payload starts with, so compressed and plain messages can
+ * share a topic.
+ *
+ * The encoder and decoder state is reused between calls. compress() and
+ * decompress() may run concurrently, but neither concurrently with itself.
+ */
+class Codec {
+public:
+    static constexpr std::string_view s_magic { "\0hs", 3 };
+    static constexpr std::size_t s_headerSize = s_magic.size() + 4;
+
+private:
+    heatshrink_encoder m_encoder;
+    heatshrink_decoder m_decoder;
+
+public:
+    static bool isCompressed(std::string_view payload);
+
+    // Fails if the result would not be smaller than the input.
+    bool compress(std::string_view in, std::string& out);
+    // Fails on a corrupt stream or if the uncompressed size exceeds the limit.
+    bool decompress(std::string_view in, std::string& out, std::size_t limit);
+};
+
+} // namespace MQTT
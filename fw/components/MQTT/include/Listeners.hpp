@@ -0,0 +1,77 @@
+#pragma once
+
+#include "types.hpp"
+
+#include "Function/InplaceFunction.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace MQTT {
+
+/**
+ * Event listeners that are dispatched without taking a lock.
+ *
+ * Every event id has an immutable snapshot of its listeners behind an atomic
+ * pointer. Appending or removing a listener copies the snapshot under a mutex
+ * and publishes the copy, so dispatching only loads a pointer. A replaced
+ * snapshot may still be iterated by a running dispatch, so it is retired and
+ * freed once no dispatch is running, by the next change or by the last
+ * dispatch to finish.
+ */
+class Listeners {
+public:
+    using Callback = Function::InplaceFunction<void(Event::Data)>;
+    using Handle = std::uint32_t;
+
+private:
+    struct Listener {
+        Handle handle;
+        Callback callback;
+    };
+    using Snapshot = std::vector<Listener>;
+
+    // Event ids range from Any (-1) to Deleted.
+    static constexpr std::size_t s_slots = static_cast<std::size_t>(static_cast<int>(Event::Id::Deleted) + 2);
+
+    std::array<std::atomic<const Snapshot*>, s_slots> m_snapshots {};
+    std::array<std::unique_ptr<const Snapshot>, s_slots> m_owned;
+    Handle m_nextHandle = 1;
+
+    // Running dispatches, replaced snapshots are freed only while there are none.
+    mutable std::atomic<std::uint32_t> m_readers = 0;
+    mutable std::atomic_bool m_retiredPending = false;
+    mutable std::vector<std::unique_ptr<const Snapshot>> m_retired;
+    mutable std::mutex m_mutex;
+
+    static std::size_t slot(Event::Id id) { return static_cast<std::size_t>(static_cast<int>(id) + 1); }
+
+    void publish(std::size_t slot, std::unique_ptr<const Snapshot> snapshot);
+    // Requires m_mutex.
+    void reclaim() const;
+    void finishDispatch() const;
+
+public:
+    Handle append(Event::Id id, Callback callback);
+    bool remove(Event::Id id, Handle handle);
+
+    void dispatch(Event::Id id, Event::Data event) const {
+        std::size_t index = slot(id);
+        if (index >= s_slots)
+            return;
+        // Sequentially consistent, so a change that sees no readers also knows none can still load the old snapshot.
+        m_readers.fetch_add(1);
+        const Snapshot* snapshot = m_snapshots[index].load();
+        if (snapshot) {
+            for (const Listener& listener : *snapshot)
+                listener.callback(event);
+        }
+        finishDispatch();
+    }
+};
+
+} // namespace MQTT
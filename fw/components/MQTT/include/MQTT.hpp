@@ -1,15 +1,27 @@
 #pragma once
 
+#include "BrokerList.hpp"
+#include "Codec.hpp"
+#include "Listeners.hpp"
+#include "Metrics.hpp"
+#include "Reassembler.hpp"
+#include "Supervisor.hpp"
+#include "SocketTransport.hpp"
+#include "TopicTable.hpp"
+#include "TopicRouter.hpp"
 #include "types.hpp"
 
-#include "eventpp/eventdispatcher.h"
+#include "Function/InplaceFunction.hpp"
 
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_tls.h"
 #include "mqtt_client.h"
 
 #include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -19,10 +31,11 @@
 namespace MQTT {
 class Client {
 public:
-    using Dispatcher = eventpp::EventDispatcher<Event::Id, void(Event::Data)>;
-    using Callback = Dispatcher::Callback;
-    using SubscribeCallback = std::function<void(std::string_view, std::string_view)>;
-    using Handle = Dispatcher::Handle;
+    using Callback = TopicRouter::Callback;
+    using SubscribeCallback = Function::InplaceFunction<void(std::string_view, std::string_view)>;
+
+    using Handle = Listeners::Handle;
+    using Subscription = TopicRouter::Handle;
 
 private:
     static constexpr const char* s_tag = "MQTT";
@@ -30,9 +43,43 @@ private:
     esp_mqtt_client_config_t m_config;
     esp_mqtt_client_handle_t m_client;
 
-    Dispatcher m_dispatcher;
-
+    Listeners m_listeners;
+    TopicRouter m_router;
+    Reassembler m_reassembler;
+    TopicTable m_topics;
+    Supervisor m_supervisor;
+    BrokerList m_brokers;
+    std::optional<SocketTransport> m_transport;
+
+    Version m_version;
+    bool m_asyncPublish;
+    std::size_t m_maxMessageSize;
+    std::mutex m_propertyMutex;
     std::atomic_bool m_connected = false;
+    std::atomic<std::uint32_t> m_pending = 0;
+    std::atomic<std::uint32_t> m_rejected = 0;
+
+    const Compression m_compression;
+    Codec m_codec;
+    std::mutex m_encoderMutex;
+    std::string m_inflated;
+    std::atomic<std::uint32_t> m_compressed = 0;
+    std::atomic<std::uint32_t> m_decompressed = 0;
+    std::atomic<std::uint32_t> m_savedBytes = 0;
+    std::atomic<std::uint32_t> m_undecodable = 0;
+
+    Metrics m_metrics;
+    std::string m_metricsTopic;
+    esp_timer_handle_t m_metricsTimer = nullptr;
+    std::uint32_t m_metricsIntervalMs;
+
+    static void publishMetrics(void* arg);
+
+    bool deflate(std::string_view message, std::string& out);
+    bool inflate(Event::Data event);
+
+    bool send(const char* topic, std::string_view message, QOS qos, bool retain, bool aliasOnly = false);
+    std::uint16_t brokerAliasMaximum();
 
     static void trampoline(void* handler_args, esp_event_base_t base, std::int32_t event_id, void* event_data);
 
@@ -51,16 +98,31 @@ public:
 
     void start();
     void stop();
-    void publish(std::string_view topic, std::string_view message, QOS qos = QOS::AtMostOnce, bool retain = false);
-    void publish(const Message& message);
+    // Returns false if the message was not accepted, e.g. because the outbox is full.
+    bool publish(std::string_view topic, std::string_view message, QOS qos = QOS::AtMostOnce, bool retain = false);
+    bool publish(std::string_view topic, std::string_view message, QOS qos, bool retain, const Properties& properties);
+    bool publish(const Message& message);
     void subscribe(std::string_view topic, QOS qos = QOS::ExactlyOnce);
-    Handle subscribe(std::string_view topic, Callback callback, QOS qos = QOS::ExactlyOnce);
+    Subscription subscribe(std::string_view topic, Callback callback, QOS qos = QOS::ExactlyOnce);
     void unsubscribe(std::string_view topic);
+    // Removes the callback only, the broker subscription is kept until unsubscribe(topic).
+    bool removeSubscription(Subscription subscription);
 
     Handle on(Event::Id event, Callback callback);
     void removeListener(Event::Id event, Handle handle);
 
     bool connected() const;
+    Reassembler::Stats reassemblyStats() const;
+    OutboxStats outboxStats() const;
+    Supervisor::Stats connectionStats() const;
+    // URI of the broker the client connects to.
+    std::string broker() const;
+    BrokerList::Stats brokerStats() const;
+    std::optional<SocketTransport::Stats> transportStats() const;
+    CompressionStats compressionStats() const;
+    const Metrics& metrics() const;
+    // All of the statistics above as one JSON object.
+    std::string metricsReport() const;
 };
 
 } // namespace MQTT
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace MQTT {
+
+/**
+ * Message counters per topic class and publish latency per QoS.
+ *
+ * The class of a topic is its level at Config::metricsClassLevel, e.g.
+ * "events" in "tet/devices/lantern/events/btnPressed" for level 3, topics
+ * with fewer levels count under the empty class. The first
+ * s_classes - 1 classes seen are counted separately, the rest together in a
+ * catch-all reported apart from them, see appendJson().
+ *
+ * Latency is the time from handing a QoS 1/2 message to esp-mqtt until its
+ * Published event, which includes the time spent in the outbox.
+ */
+class Metrics {
+public:
+    static constexpr std::size_t s_classes = 8;
+    static constexpr std::size_t s_nameSize = 16;
+
+    struct Traffic {
+        std::uint32_t messages;
+        std::uint32_t bytes;
+    };
+
+    struct Class {
+        std::string_view name;
+        Traffic in;
+        Traffic out;
+    };
+
+    struct Latency {
+        std::uint32_t samples;
+        std::uint32_t averageUs;
+        std::uint32_t maxUs;
+    };
+
+private:
+    struct Counters {
+        std::atomic<std::uint32_t> messages = 0;
+        std::atomic<std::uint32_t> bytes = 0;
+
+        void add(std::size_t size) {
+            ++messages;
+            bytes += static_cast<std::uint32_t>(size);
+        }
+
+        Traffic load() const { return { messages.load(), bytes.load() }; }
+    };
+
+    struct Slot {
+        std::array<char, s_nameSize> name {};
+        std::size_t length = 0;
+        Counters in;
+        Counters out;
+
+        std::string_view view() const { return { name.data(), length }; }
+    };
+
+    struct InFlight {
+        int id = -1;
+        std::int64_t since = 0;
+        std::uint8_t qos = 0;
+    };
+
+    struct LatencyCounters {
+        std::uint32_t samples = 0;
+        std::uint64_t totalUs = 0;
+        std::uint32_t maxUs = 0;
+    };
+
+    const std::size_t m_classLevel;
+
+    std::array<Slot, s_classes> m_slots;
+    std::atomic<std::size_t> m_used = 0;
+
+    std::array<InFlight, 32> m_inFlight;
+    std::size_t m_nextInFlight = 0;
+    std::array<LatencyCounters, 3> m_latency;
+
+    mutable std::mutex m_mutex;
+
+    std::string_view classOf(std::string_view topic) const;
+    Slot& slot(std::string_view topic);
+
+public:
+    explicit Metrics(std::size_t classLevel);
+
+    void received(std::string_view topic, std::size_t bytes);
+    void sent(std::string_view topic, std::size_t bytes, QOS qos, int id);
+    void acknowledged(int id);
+
+    std::size_t classCount() const { return m_used.load(std::memory_order_acquire); }
+    Class traffic(std::size_t index) const;
+    Latency latency(QOS qos) const;
+
+    // Appends the counters as JSON members, without the enclosing braces: "classes" by name,
+    // the catch-all as "otherClasses" and "latency" per QoS.
+    void appendJson(std::string& out) const;
+};
+
+} // namespace MQTT
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "types.hpp"
+
+#include "mqtt_client.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace MQTT {
+
+/**
+ * Joins messages that esp-mqtt delivers in several MQTT_EVENT_DATA chunks.
+ *
+ * Buffers are only allocated for the first fragmented message that needs
+ * them, grow to the largest such message and are then reused, so a client
+ * that only receives small messages allocates nothing. A message whose topic
+ * and payload exceed the capacity is dropped and counted, as are messages for
+ * which no buffer is free or can be allocated and messages whose chunks did
+ * not arrive in order. Messages delivered in a single chunk are passed through
+ * without copying.
+ *
+ * Only used from the MQTT task, except for stats().
+ */
+class Reassembler {
+public:
+    struct Stats {
+        std::uint32_t reassembled;
+        std::uint32_t oversized;
+        std::uint32_t exhausted;
+        std::uint32_t incomplete;
+    };
+
+private:
+    struct Buffer {
+        std::unique_ptr<char[]> data;
+        std::size_t size = 0;
+        std::size_t topicLength = 0;
+        std::size_t received = 0;
+        std::size_t total = 0;
+        bool used = false;
+    };
+
+    const std::size_t m_capacity;
+    std::vector<Buffer> m_pool;
+    Buffer* m_current = nullptr;
+    Buffer* m_delivered = nullptr;
+    esp_mqtt_event_t m_event {};
+
+    std::atomic<std::uint32_t> m_reassembled = 0;
+    std::atomic<std::uint32_t> m_oversized = 0;
+    std::atomic<std::uint32_t> m_exhausted = 0;
+    std::atomic<std::uint32_t> m_incomplete = 0;
+
+    Buffer* acquire(std::size_t size);
+    void drop();
+
+public:
+    Reassembler(std::size_t buffers, std::size_t capacity);
+
+    Reassembler(const Reassembler&) = delete;
+    Reassembler& operator=(const Reassembler&) = delete;
+
+    /**
+     * Returns the event to deliver: `event` itself for unfragmented messages,
+     * an event describing the joined message once its last chunk arrived, or
+     * nullptr while chunks are pending or the message was dropped. A joined
+     * message is only valid until release() is called.
+     */
+    Event::Data feed(Event::Data event);
+    void release();
+
+    // Drops a partially received message, e.g. after the connection was lost.
+    void reset();
+
+    Stats stats() const;
+};
+
+} // namespace MQTT
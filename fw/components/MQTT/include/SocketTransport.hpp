@@ -0,0 +1,103 @@
+#pragma once
+
+#include "TlsSessionCache.hpp"
+#include "types.hpp"
+
+#include "esp_tls.h"
+#include "esp_transport.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace MQTT {
+
+/**
+ * esp-tls transport for esp-mqtt, over TLS or plain TCP.
+ *
+ * With Config::resumeTlsSessions it resumes the previous TLS session on
+ * reconnect, see TlsSessionCache. esp-mqtt's own SSL transport starts every
+ * connection with a full handshake, which costs certificate verification on
+ * the ESP32. The broker may decline the session, that falls back to a full
+ * handshake.
+ *
+ * Small PUBLISH packets may be held back and coalesced, see Coalescing.
+ * Every other packet flushes the held ones and is written right away.
+ *
+ * esp-mqtt destroys the transport handle together with the client.
+ */
+class SocketTransport {
+public:
+    struct Stats {
+        std::uint32_t handshakes;
+        std::uint32_t resumptions; // Handshakes that offered a cached session.
+        std::uint32_t failures;
+        std::uint32_t lastFullMs;
+        std::uint32_t lastResumedMs;
+        std::uint32_t coalesced; // PUBLISH packets that were held back.
+        std::uint32_t flushes; // Socket writes of held packets.
+    };
+
+private:
+    static constexpr const char* s_tag = "MQTT::SocketTransport";
+
+    const bool m_secure;
+    const Coalescing m_coalescing;
+
+    std::string m_serverCertificate;
+    std::string m_clientCertificate;
+    std::string m_clientKey;
+    esp_tls_cfg_t m_config = {};
+
+    esp_transport_handle_t m_transport = nullptr;
+    esp_tls_t* m_tls = nullptr;
+    std::string m_host;
+    std::optional<TlsSessionCache> m_sessions; // Only set if sessions are resumed.
+
+    // Blocking publishes write from the caller's task while the esp-mqtt task flushes on poll,
+    // so the held packets and their state are only touched under m_heldMutex.
+    std::mutex m_heldMutex;
+    std::string m_held;
+    std::int64_t m_deadline = 0; // esp_timer time at which the held packets have to be written.
+    bool m_failed = false; // A flush failed, reported by the next read.
+
+    std::atomic<std::uint32_t> m_handshakes = 0;
+    std::atomic<std::uint32_t> m_resumptions = 0;
+    std::atomic<std::uint32_t> m_failures = 0;
+    std::atomic<std::uint32_t> m_lastFullMs = 0;
+    std::atomic<std::uint32_t> m_lastResumedMs = 0;
+    std::atomic<std::uint32_t> m_coalesced = 0;
+    std::atomic<std::uint32_t> m_flushes = 0;
+
+    static SocketTransport& self(esp_transport_handle_t transport);
+    static int connect(esp_transport_handle_t transport, const char* host, int port, int timeoutMs);
+    static int read(esp_transport_handle_t transport, char* buffer, int length, int timeoutMs);
+    static int write(esp_transport_handle_t transport, const char* buffer, int length, int timeoutMs);
+    static int pollRead(esp_transport_handle_t transport, int timeoutMs);
+    static int pollWrite(esp_transport_handle_t transport, int timeoutMs);
+    static int close(esp_transport_handle_t transport);
+    static int destroy(esp_transport_handle_t transport);
+
+    int poll(int timeoutMs, bool read) const;
+    int writeAll(const char* buffer, int length, int timeoutMs);
+    // Both require m_heldMutex.
+    bool hold(const char* buffer, int length);
+    bool flush(int timeoutMs);
+    int waitReadable(int timeoutMs);
+    void saveSession();
+    void disconnect();
+
+public:
+    SocketTransport(const Config& config, bool secure);
+    ~SocketTransport();
+
+    SocketTransport(const SocketTransport&) = delete;
+    SocketTransport& operator=(const SocketTransport&) = delete;
+
+    esp_transport_handle_t handle() const { return m_transport; }
+    Stats stats() const;
+};
+
+} // namespace MQTT
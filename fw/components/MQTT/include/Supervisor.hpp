@@ -0,0 +1,67 @@
+#pragma once
+
+#include "types.hpp"
+
+#include "esp_timer.h"
+#include "mqtt_client.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace MQTT {
+
+/**
+ * Reconnects the client with jittered exponential backoff.
+ *
+ * esp-mqtt retries after a fixed delay, so after a broker restart every
+ * device comes back at the same moment. Here the n-th attempt waits a random
+ * time between half and all of min(initial * 2^n, max).
+ */
+class Supervisor {
+public:
+    struct Stats {
+        std::uint32_t reconnects; // Connections established after a disconnect.
+        std::uint32_t attempts; // Connection attempts since the last disconnect.
+        std::uint32_t lastOutageMs; // Disconnect to connected, of the last reconnect.
+        std::uint32_t maxOutageMs;
+        bool sessionPresent; // The broker kept the session of the last connection.
+    };
+
+private:
+    static constexpr const char* s_tag = "MQTT::Supervisor";
+
+    const Backoff m_backoff;
+    esp_mqtt_client_handle_t m_client = nullptr;
+    esp_timer_handle_t m_timer = nullptr;
+
+    std::atomic_bool m_running = false;
+    std::atomic<std::uint32_t> m_attempt = 0;
+    // Used from the esp-mqtt task and, by failed reconnects, from the esp_timer task.
+    std::atomic<std::int64_t> m_disconnectedAt = 0;
+
+    std::atomic<std::uint32_t> m_reconnects = 0;
+    std::atomic<std::uint32_t> m_lastOutageMs = 0;
+    std::atomic<std::uint32_t> m_maxOutageMs = 0;
+    std::atomic_bool m_sessionPresent = false;
+
+    static void onTimer(void* arg);
+
+public:
+    explicit Supervisor(const Backoff& backoff);
+    ~Supervisor();
+
+    Supervisor(const Supervisor&) = delete;
+    Supervisor& operator=(const Supervisor&) = delete;
+
+    void attach(esp_mqtt_client_handle_t client);
+    void start();
+    void stop();
+
+    void connected(bool sessionPresent);
+    void disconnected();
+
+    std::uint32_t delayMs(std::uint32_t attempt) const;
+    Stats stats() const;
+};
+
+} // namespace MQTT
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "esp_tls.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MQTT {
+
+/**
+ * The TLS session of the last connection, offered on the next connect so the
+ * broker can resume it instead of running a full handshake.
+ *
+ * A session is only offered to the host it was made with, a fallback broker
+ * gets a full handshake. The session is kept in RAM. With an NVS namespace it
+ * is also stored there and loaded on construction, so the first connection
+ * after a reboot resumes as well. The stored session contains its master
+ * secret, only persist it with NVS encryption enabled.
+ *
+ * Needs CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS, persisting also mbedTLS as the
+ * esp-tls stack. Without them nothing is kept.
+ */
+class TlsSessionCache {
+    static constexpr const char* s_tag = "MQTT::TlsSessionCache";
+
+    const std::string m_namespace;
+    std::string m_host;
+    esp_tls_client_session_t* m_session = nullptr;
+    std::vector<std::uint8_t> m_stored; // The session as last written to NVS.
+
+    void load();
+    void store();
+
+public:
+    // An empty namespace keeps the session in RAM only.
+    explicit TlsSessionCache(std::string nvsNamespace = "");
+    ~TlsSessionCache();
+
+    TlsSessionCache(const TlsSessionCache&) = delete;
+    TlsSessionCache& operator=(const TlsSessionCache&) = delete;
+
+    // The session to offer to host, null if there is none. Stays owned by the cache.
+    esp_tls_client_session_t* session(const std::string& host) const;
+    // Takes over the current session of tls, replacing the one kept so far.
+    void save(esp_tls_t* tls, const std::string& host);
+};
+
+} // namespace MQTT
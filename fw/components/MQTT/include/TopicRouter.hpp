@@ -0,0 +1,89 @@
+#pragma once
+
+#include "types.hpp"
+
+#include "Function/InplaceFunction.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MQTT {
+
+/**
+ * Routes incoming messages to the callbacks of matching subscriptions.
+ *
+ * Topic filters are stored in a trie with one node per topic level, so
+ * dispatching a message costs O(topic depth) instead of O(subscriptions).
+ * Wildcards follow the MQTT specification: "+" matches exactly one level,
+ * "#" matches the parent level and any number of levels below it, and
+ * wildcards at the first level do not match topics starting with "$".
+ *
+ * Like Listeners, dispatching takes no lock. The trie is an immutable
+ * snapshot behind an atomic pointer, adding or removing a subscription copies
+ * it under a mutex and publishes the copy. Replaced snapshots are freed once
+ * no dispatch is running. Callbacks may subscribe and unsubscribe, which takes
+ * effect from the next message.
+ */
+class TopicRouter {
+public:
+    using Callback = Function::InplaceFunction<void(Event::Data)>;
+    using Handle = std::uint32_t;
+
+    static constexpr Handle s_invalidHandle = 0;
+
+private:
+    struct Subscription {
+        Handle handle;
+        Callback callback;
+    };
+
+    struct Node {
+        std::map<std::string, std::unique_ptr<Node>, std::less<>> children;
+        std::unique_ptr<Node> singleLevel;
+        std::vector<Subscription> multiLevel;
+        std::vector<Subscription> exact;
+    };
+
+    std::atomic<const Node*> m_snapshot = nullptr;
+    std::unique_ptr<const Node> m_owned;
+    Handle m_nextHandle = 1;
+    std::size_t m_size = 0;
+
+    // Running dispatches, replaced snapshots are freed only while there are none.
+    mutable std::atomic<std::uint32_t> m_readers = 0;
+    mutable std::atomic_bool m_retiredPending = false;
+    mutable std::vector<std::unique_ptr<const Node>> m_retired;
+    mutable std::mutex m_mutex;
+
+    // Copies the trie, leaving out subtrees without subscriptions. Null if the whole trie is empty.
+    static std::unique_ptr<Node> copy(const Node& node);
+    static std::size_t invoke(const std::vector<Subscription>& subscriptions, Event::Data event);
+    static bool remove(std::vector<Subscription>& subscriptions, Handle handle);
+    static bool remove(Node& node, Handle handle);
+
+    static std::size_t dispatch(const Node& node, std::string_view rest, bool end, bool root, Event::Data event);
+
+    void publish(std::unique_ptr<const Node> snapshot);
+    // Requires m_mutex.
+    void reclaim() const;
+    void finishDispatch() const;
+
+public:
+    static bool isValidFilter(std::string_view filter);
+
+    Handle add(std::string_view filter, Callback callback);
+    bool remove(Handle handle);
+
+    // Returns the number of callbacks that were invoked.
+    std::size_t dispatch(std::string_view topic, Event::Data event) const;
+
+    std::size_t size() const;
+};
+
+} // namespace MQTT
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace MQTT {
+
+/**
+ * Owns NUL-terminated copies of topics handed to esp-mqtt.
+ *
+ * The first capacity distinct topics are stored once and their pointers
+ * stay valid for the lifetime of the table, which covers the fixed set of
+ * topics a device publishes and subscribes to. Further topics are copied into
+ * a buffer of the calling thread instead, valid until its next call, so
+ * topics built from changing data cannot grow the table without bound.
+ *
+ * The first published topics in the table also get an MQTT 5 topic alias, in the order
+ * they are first seen, up to the configured number or the broker's maximum
+ * set by limitAliases(). Aliases belong to a network connection, so they are
+ * cleared by resetAliases() when it is lost and assigned anew.
+ */
+class TopicTable {
+public:
+    struct Entry {
+        const char* topic;
+        std::uint16_t alias; // 0 if the topic has none.
+        bool announced; // The broker has seen the alias with its topic on this connection.
+    };
+
+private:
+    struct Alias {
+        std::uint16_t id = 0;
+        bool announced = false;
+    };
+
+    std::map<std::string, Alias, std::less<>> m_topics;
+    const std::size_t m_capacity;
+    const std::uint16_t m_maxAliases;
+    std::uint16_t m_aliases;
+    std::uint16_t m_nextAlias = 1;
+    mutable std::mutex m_mutex;
+
+public:
+    explicit TopicTable(std::uint16_t aliases = 0, std::size_t capacity = 32)
+        : m_capacity(capacity)
+        , m_maxAliases(aliases)
+        , m_aliases(aliases) {}
+
+    // The returned topic is NUL-terminated, only valid until the thread's next call if the table is full.
+    const char* intern(std::string_view topic);
+    // Topics outside the table get no alias.
+    Entry internWithAlias(std::string_view topic);
+    // Marks the alias as known to the broker, after a publish carrying both was sent.
+    void announce(std::uint16_t alias);
+    void resetAliases();
+    // Uses at most maximum aliases on this connection, the broker's limit from its CONNACK.
+    void limitAliases(std::uint16_t maximum);
+    std::uint16_t maxAliases() const { return m_maxAliases; }
+    std::size_t size() const;
+};
+
+} // namespace MQTT
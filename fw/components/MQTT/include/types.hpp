@@ -2,9 +2,14 @@
 
 #include "mqtt_client.h"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
 #include <variant>
+#include <vector>
 
 namespace MQTT {
 enum class QOS {
@@ -52,12 +57,60 @@ enum class Id {
 using Data = esp_mqtt_event_handle_t;
 } // namespace Event
 
+using UserProperty = esp_mqtt5_user_property_item_t;
+
+// MQTT 5 publish properties, ignored on older protocol versions.
+struct Properties {
+    std::uint32_t messageExpiry = 0; // Seconds the broker may hold the message, 0 means forever.
+    std::span<const UserProperty> userProperties = {};
+};
+
+struct Backoff {
+    std::uint32_t initialMs = 1000;
+    std::uint32_t maxMs = 60 * 1000;
+};
+
+// The server decompresses any payload, other devices only with compression enabled.
+enum class CompressionMode {
+    Off, // Compressed messages are not recognised either, they reach the handlers as they are.
+    Always,
+};
+
+struct Compression {
+    CompressionMode mode = CompressionMode::Off;
+    std::size_t threshold = 512; // Smaller payloads are sent as they are.
+};
+
+struct CompressionStats {
+    std::uint32_t compressed;
+    std::uint32_t decompressed;
+    std::uint32_t savedBytes; // Outgoing bytes saved by compression.
+    std::uint32_t undecodable; // Incoming compressed messages that were dropped.
+};
+
+/**
+ * Holds small PUBLISH packets back so several go out in one socket write.
+ * Message boundaries are kept, only the TCP segments and Wi-Fi frames are shared.
+ */
+struct Coalescing {
+    // How long a publish of each QoS may be held, 0 writes it right away.
+    std::array<std::uint32_t, 3> holdUs = { 0, 0, 0 };
+    // Held bytes at which they are written regardless of the hold time.
+    std::size_t maxBytes = 1024;
+
+    bool enabled() const { return holdUs[0] || holdUs[1] || holdUs[2]; }
+};
+
 struct NoCertificate {};
 struct UseGlobalStore {};
 using BundleAttacher = esp_err_t (*)(void* conf);
 
 struct Config {
     std::string host;
+    // Further brokers the client fails over to, see BrokerList. The host is preferred on equal round trips.
+    std::vector<std::string> fallbackHosts = {};
+    // How long a broker may take to accept a TCP connection before it counts as unreachable.
+    std::uint32_t probeTimeoutMs = 1000;
     std::optional<std::string> user = std::nullopt;
     std::optional<std::string> password = std::nullopt;
     std::variant<NoCertificate, std::string, BundleAttacher, UseGlobalStore> serverCertificate = NoCertificate{};
@@ -65,6 +118,50 @@ struct Config {
     std::optional<std::string> clientKey = std::nullopt;
     std::optional<Message> will = std::nullopt;
     std::optional<std::string> clientId = std::nullopt;
+    Version version = Version::V3_1_1;
+    // MQTT 5 topic aliases used for published topics, lowered to the broker's maximum on connect.
+    std::uint16_t topicAliases = 10;
+    // Distinct topics kept as copies for esp-mqtt, further ones are copied on every call, see TopicTable.
+    std::size_t internedTopics = 32;
+
+    // False asks for a persistent session, which keeps subscriptions and queued QoS 1/2 messages
+    // across reconnects. Needs a clientId that stays the same, the broker holds the session meanwhile.
+    bool cleanSession = true;
+    // MQTT 5 only, seconds the broker keeps a persistent session after a disconnect.
+    std::uint32_t sessionExpiry = 60 * 60;
+    std::uint16_t keepalive = 120;
+    Backoff reconnect = {};
+    // For mqtts:// hosts, reconnect with the previous TLS session instead of a full handshake.
+    // This replaces the esp-mqtt SSL transport with SocketTransport, so it is off by default.
+    bool resumeTlsSessions = false;
+    // Also keeps the TLS session in this NVS namespace, so it is resumed after a reboot.
+    // Empty keeps it in RAM only. The session contains its secret, only use this with NVS encryption.
+    std::string tlsSessionNamespace = "";
+    Compression compression = {};
+    Coalescing coalescing = {};
+
+    // Topic level that names the class messages are counted under, see Metrics.
+    std::size_t metricsClassLevel = 3;
+    // If set, Client::metricsReport() is published there periodically.
+    std::optional<std::string> metricsTopic = std::nullopt;
+    std::uint32_t metricsIntervalMs = 60 * 1000;
+
+    // Messages esp-mqtt delivers in several chunks are joined in one of these buffers,
+    // which are allocated by the first such message and hold at most maxMessageSize bytes.
+    std::size_t reassemblyBuffers = 1;
+    std::size_t maxMessageSize = 16 * 1024;
+
+    // Publishes are queued for the esp-mqtt task instead of being written from the caller.
+    // Off by default, a queued QoS 0 publish is no longer sent before publish() returns.
+    bool asyncPublish = false;
+    // Outbox size in bytes at which further publishes are rejected, 0 means unlimited.
+    std::size_t outboxLimit = 32 * 1024;
+};
+
+struct OutboxStats {
+    std::size_t bytes; // Held by the esp-mqtt outbox, queued and unacknowledged.
+    std::uint32_t pending; // QoS 1 and 2 publishes without PUBACK/PUBCOMP yet.
+    std::uint32_t rejected; // Publishes dropped because the outbox was full.
 };
 
 } // namespace MQTT
\ No newline at end of file
@@ -0,0 +1,567 @@
+#include "Station.hpp"
+
+#include "esp_log.h"
+#include "esp_random.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Better secured APs win over slightly stronger ones, in dB.
+int securityBonus(wifi_auth_mode_t authmode) {
+    switch (authmode) {
+    case WIFI_AUTH_WPA3_PSK:
+    case WIFI_AUTH_WPA2_WPA3_PSK:
+        return 4;
+    case WIFI_AUTH_WPA2_PSK:
+    case WIFI_AUTH_WPA_WPA2_PSK:
+        return 2;
+    case WIFI_AUTH_OPEN:
+    case WIFI_AUTH_WEP:
+        return -6;
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+Station::Station(const Config& config)
+    : m_config(config) {
+    const esp_timer_create_args_t args = {
+        .callback = onTimer,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "wifi_station",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&args, &m_timer) != ESP_OK)
+        throw std::runtime_error("Failed to create Wi-Fi station timer");
+
+    WiFi& wifi = WiFi::singleton();
+    m_wifiHandles = {
+        { WIFI_EVENT_SCAN_DONE, wifi.on(WIFI_EVENT_SCAN_DONE, [this](const wifi_event_sta_scan_done_t*) { scanDone(); }) },
+        { WIFI_EVENT_STA_CONNECTED, wifi.on(WIFI_EVENT_STA_CONNECTED, [this](const wifi_event_sta_connected_t*) { onConnected(); }) },
+        { WIFI_EVENT_STA_DISCONNECTED, wifi.on(WIFI_EVENT_STA_DISCONNECTED, [this](const wifi_event_sta_disconnected_t* event) { onDisconnected(event); }) },
+        { WIFI_EVENT_STA_BSS_RSSI_LOW, wifi.on(WIFI_EVENT_STA_BSS_RSSI_LOW, [this](const wifi_event_bss_rssi_low_t* event) { onRssiLow(event); }) },
+    };
+    m_netifHandles = {
+        { IP_EVENT_STA_GOT_IP, NetIf::on(IP_EVENT_STA_GOT_IP, [this](const ip_event_got_ip_t* event) { onGotIP(event); }) },
+        { IP_EVENT_STA_LOST_IP, NetIf::on(IP_EVENT_STA_LOST_IP, [this]() { onLostIP(); }) },
+    };
+}
+
+Station::~Station() {
+    stop();
+    for (auto [event, handle] : m_wifiHandles)
+        WiFi::singleton().removeListener(event, handle);
+    for (auto [event, handle] : m_netifHandles)
+        NetIf::removeListener(event, handle);
+    esp_timer_delete(m_timer);
+}
+
+void Station::start() {
+    std::scoped_lock lock(m_mutex);
+    if (m_state != State::Idle)
+        return;
+
+    WiFi::singleton().startStation();
+    m_round = 0;
+    m_attempts = 0;
+    m_disconnectedAt = esp_timer_get_time();
+    m_staticLease = false;
+
+    m_cache = loadCache();
+    if (auto candidate = cachedCandidate()) {
+        m_candidates = { *candidate };
+        m_next = 0;
+        m_directed = true;
+        associateNext();
+    } else {
+        scan();
+    }
+}
+
+void Station::stop() {
+    std::scoped_lock lock(m_mutex);
+    if (m_state == State::Idle)
+        return;
+    esp_timer_stop(m_timer);
+    m_roamScan = false;
+    transition(State::Idle);
+    esp_wifi_disconnect();
+}
+
+void Station::transition(State state) {
+    State previous = m_state;
+    if (previous == state)
+        return;
+    m_state = state;
+    ESP_LOGI(s_tag, "State %d -> %d", static_cast<int>(previous), static_cast<int>(state));
+    m_dispatcher.dispatch(state, previous);
+}
+
+void Station::arm(std::uint32_t ms) {
+    esp_timer_stop(m_timer);
+    esp_timer_start_once(m_timer, static_cast<std::uint64_t>(ms) * 1000);
+}
+
+void Station::onTimer(void* arg) {
+    auto station = static_cast<Station*>(arg);
+    std::scoped_lock lock(station->m_mutex);
+
+    switch (station->m_state) {
+    case State::Scanning:
+        ESP_LOGW(s_tag, "Scan timed out");
+        esp_wifi_scan_stop();
+        station->wait();
+        break;
+    case State::Associating:
+    case State::ObtainingIP:
+        ESP_LOGW(s_tag, "%s timed out", station->m_state == State::Associating ? "Association" : "DHCP");
+        esp_wifi_disconnect();
+        station->failed();
+        break;
+    case State::Waiting:
+        station->scan();
+        break;
+    case State::Connected:
+        // Also gives up on a background scan that never finished.
+        station->m_roamScan = false;
+        station->armRoaming();
+        break;
+    default:
+        break;
+    }
+}
+
+void Station::scan() {
+    m_directed = false;
+    transition(State::Scanning);
+    esp_err_t err = esp_wifi_scan_start(nullptr, false);
+    if (err != ESP_OK) {
+        ESP_LOGE(s_tag, "Failed to start scan: %s", esp_err_to_name(err));
+        wait();
+        return;
+    }
+    arm(m_config.scanTimeoutMs);
+}
+
+void Station::scanDone() {
+    std::scoped_lock lock(m_mutex);
+    bool roaming = m_roamScan && m_state == State::Connected;
+    m_roamScan = false;
+    if (m_state != State::Scanning && !roaming)
+        return;
+    esp_timer_stop(m_timer);
+
+    std::uint16_t count = 0;
+    esp_wifi_scan_get_ap_num(&count);
+    std::vector<wifi_ap_record_t> records(count);
+    if (count && esp_wifi_scan_get_ap_records(&count, records.data()) != ESP_OK)
+        count = 0;
+    records.resize(count);
+
+    std::vector<Candidate> candidates = rank(records);
+    if (roaming) {
+        roam(candidates);
+        return;
+    }
+
+    ESP_LOGI(s_tag, "%u APs in range, %u candidates", static_cast<unsigned>(count), static_cast<unsigned>(candidates.size()));
+    m_candidates = std::move(candidates);
+    m_next = 0;
+    associateNext();
+}
+
+// Every AP of every known network, best first.
+std::vector<Station::Candidate> Station::rank(const std::vector<wifi_ap_record_t>& records) const {
+    std::vector<Candidate> candidates;
+    for (std::size_t i = 0; i < m_config.networks.size(); ++i) {
+        const Network& network = m_config.networks[i];
+        for (const auto& record : records) {
+            if (network.ssid != reinterpret_cast<const char*>(record.ssid))
+                continue;
+            // A password is needed exactly for secured APs, the other combinations fail anyway.
+            bool open = record.authmode == WIFI_AUTH_OPEN || record.authmode == WIFI_AUTH_OWE;
+            if (network.password.empty() != open)
+                continue;
+
+            Candidate candidate {
+                .network = i,
+                .bssid = Bssid {},
+                .channel = record.primary,
+                .rssi = record.rssi,
+                .authmode = record.authmode,
+            };
+            std::copy_n(record.bssid, 6, candidate.bssid->begin());
+            candidate.cached = m_cache && m_cache->ssid == network.ssid && m_cache->bssid == *candidate.bssid;
+            candidate.rank = record.rssi + securityBonus(record.authmode);
+            if (auto history = m_history.find(*candidate.bssid); history != m_history.end())
+                candidate.rank += s_successBonus * history->second.successes - s_failurePenalty * history->second.failures;
+            candidates.push_back(candidate);
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.rank > b.rank;
+    });
+    return candidates;
+}
+
+// Moves to the best candidate that is clearly stronger than the connected AP, the old one is the fallback.
+void Station::roam(const std::vector<Candidate>& candidates) {
+    wifi_ap_record_t connected = {};
+    if (esp_wifi_sta_get_ap_info(&connected) != ESP_OK) {
+        arm(m_config.roaming.intervalMs);
+        return;
+    }
+
+    Bssid bssid;
+    std::copy_n(connected.bssid, 6, bssid.begin());
+    auto better = std::find_if(candidates.begin(), candidates.end(), [&](const Candidate& candidate) {
+        return *candidate.bssid != bssid && candidate.rssi >= connected.rssi + m_config.roaming.hysteresisDb;
+    });
+    if (better == candidates.end()) {
+        ESP_LOGI(s_tag, "No AP clearly stronger than %d dBm", connected.rssi);
+        arm(m_config.roaming.intervalMs);
+        return;
+    }
+
+    ESP_LOGI(s_tag, "Roaming from %d dBm to %d dBm on channel %u", connected.rssi, better->rssi, static_cast<unsigned>(better->channel));
+    ++m_roams;
+    m_disconnectedAt = esp_timer_get_time();
+    m_round = 0;
+    m_candidates = { *better };
+    if (m_current)
+        m_candidates.push_back(*m_current);
+    m_next = 0;
+    m_directed = true;
+    // The disconnect event of the old AP arrives during the next attempt and is ignored by its BSSID.
+    esp_wifi_disconnect();
+    associateNext();
+}
+
+// The driver reports a weak signal once per call.
+void Station::armRoaming() {
+    if (m_config.roaming.thresholdDbm != 0)
+        esp_wifi_set_rssi_threshold(m_config.roaming.thresholdDbm);
+}
+
+void Station::associateNext() {
+    if (m_next >= m_candidates.size()) {
+        if (m_directed)
+            scan();
+        else
+            wait();
+        return;
+    }
+    associate(m_candidates[m_next++]);
+}
+
+void Station::associate(const Candidate& candidate) {
+    const Network& network = m_config.networks[candidate.network];
+    m_current = candidate;
+    ++m_attempts;
+    transition(State::Associating);
+
+    wifi_config_t config = {};
+    std::copy_n(network.ssid.data(), std::min<std::size_t>(network.ssid.size(), sizeof(config.sta.ssid)), config.sta.ssid);
+    std::copy_n(network.password.data(), std::min<std::size_t>(network.password.size(), sizeof(config.sta.password)), config.sta.password);
+    if (candidate.bssid) {
+        config.sta.bssid_set = true;
+        std::copy_n(candidate.bssid->begin(), 6, config.sta.bssid);
+    }
+    config.sta.channel = candidate.channel;
+    // Keeps the driver from accepting a weaker security than the scan reported.
+    config.sta.threshold.authmode = candidate.authmode;
+
+    bool reuse = candidate.cached && m_config.reuseLease && m_cache && m_cache->lease;
+    useLease(reuse ? &*m_cache->lease : nullptr);
+
+    ESP_LOGI(s_tag, "Associating with %s on channel %u%s", network.ssid.c_str(), static_cast<unsigned>(candidate.channel), m_directed ? " without scanning" : "");
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &config);
+    if (err == ESP_OK)
+        err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGE(s_tag, "Failed to associate: %s", esp_err_to_name(err));
+        failed();
+        return;
+    }
+    arm(m_directed ? m_config.directedTimeoutMs : m_config.associateTimeoutMs);
+}
+
+void Station::failed() {
+    esp_timer_stop(m_timer);
+    if (m_current && m_current->bssid) {
+        History& history = m_history[*m_current->bssid];
+        history.failures = std::min<std::uint16_t>(history.failures + 1, s_historyLimit);
+    }
+    associateNext();
+}
+
+void Station::wait() {
+    std::uint32_t delay = delayMs(m_round++);
+    ESP_LOGI(s_tag, "Next scan in %lu ms", static_cast<unsigned long>(delay));
+    transition(State::Waiting);
+    arm(delay);
+}
+
+void Station::onConnected() {
+    std::scoped_lock lock(m_mutex);
+    if (m_state != State::Associating)
+        return;
+    transition(State::ObtainingIP);
+    arm(m_config.ipTimeoutMs);
+}
+
+void Station::onDisconnected(const wifi_event_sta_disconnected_t* event) {
+    std::scoped_lock lock(m_mutex);
+    switch (m_state) {
+    case State::Connected:
+        ESP_LOGW(s_tag, "Lost AP, reason %u", static_cast<unsigned>(event->reason));
+        if (m_roamScan) {
+            esp_wifi_scan_stop();
+            m_roamScan = false;
+        }
+        m_disconnectedAt = esp_timer_get_time();
+        m_round = 0;
+        // Most outages are short, so the AP that was just lost is tried again before scanning.
+        m_candidates = { *m_current };
+        m_next = 0;
+        m_directed = true;
+        associateNext();
+        break;
+    case State::Associating:
+        // Disconnects of an earlier attempt may arrive after the next one started.
+        if (m_current && m_current->bssid && !std::equal(m_current->bssid->begin(), m_current->bssid->end(), event->bssid))
+            return;
+        ESP_LOGI(s_tag, "Association failed, reason %u", static_cast<unsigned>(event->reason));
+        failed();
+        break;
+    case State::ObtainingIP:
+        failed();
+        break;
+    default:
+        break;
+    }
+}
+
+void Station::onGotIP(const ip_event_got_ip_t* event) {
+    std::scoped_lock lock(m_mutex);
+    if (m_state != State::ObtainingIP)
+        return;
+    esp_timer_stop(m_timer);
+
+    if (m_directed)
+        ++m_directedConnects;
+    if (!m_everConnected) {
+        auto sinceBoot = static_cast<std::uint32_t>(esp_timer_get_time() / 1000);
+        m_bootToConnectedMs = sinceBoot;
+        if (sinceBoot > s_bootTargetMs)
+            ESP_LOGW(s_tag, "Connected %lu ms after boot, %s", static_cast<unsigned long>(sinceBoot), m_directed ? "without scanning" : "after a scan");
+        else
+            ESP_LOGI(s_tag, "Connected %lu ms after boot, %s", static_cast<unsigned long>(sinceBoot), m_directed ? "without scanning" : "after a scan");
+    } else {
+        auto outage = static_cast<std::uint32_t>((esp_timer_get_time() - m_disconnectedAt) / 1000);
+        m_lastOutageMs = outage;
+        m_maxOutageMs = std::max(m_maxOutageMs.load(), outage);
+        ++m_reconnects;
+        ESP_LOGI(s_tag, "Reconnected after %lu ms", static_cast<unsigned long>(outage));
+    }
+    m_everConnected = true;
+    m_round = 0;
+    m_attempts = 0;
+    if (m_current && m_current->bssid) {
+        History& history = m_history[*m_current->bssid];
+        history.successes = std::min<std::uint16_t>(history.successes + 1, s_historyLimit);
+        history.failures = 0;
+    }
+    armRoaming();
+
+    if (m_current && m_current->bssid && event) {
+        esp_netif_dns_info_t dns = {};
+        esp_netif_get_dns_info(event->esp_netif, ESP_NETIF_DNS_MAIN, &dns);
+        storeCache({
+            .ssid = m_config.networks[m_current->network].ssid,
+            .bssid = *m_current->bssid,
+            .channel = m_current->channel,
+            .authmode = m_current->authmode,
+            .lease = Lease {
+                .ip = event->ip_info.ip.addr,
+                .netmask = event->ip_info.netmask.addr,
+                .gateway = event->ip_info.gw.addr,
+                .dns = dns.ip.u_addr.ip4.addr,
+            },
+        });
+    }
+    transition(State::Connected);
+}
+
+// The AP is still associated, DHCP keeps trying to renew the lease.
+void Station::onLostIP() {
+    std::scoped_lock lock(m_mutex);
+    if (m_state != State::Connected)
+        return;
+    m_disconnectedAt = esp_timer_get_time();
+    transition(State::ObtainingIP);
+    arm(m_config.ipTimeoutMs);
+}
+
+std::optional<Station::Cache> Station::loadCache() const {
+    if (m_config.cacheNamespace.empty())
+        return std::nullopt;
+    try {
+        NVS nvs(m_config.cacheNamespace);
+        // Without the security the directed attempt would accept an open AP, so such a cache is ignored.
+        if (!nvs.contains("ssid") || !nvs.contains("bssid") || !nvs.contains("channel") || !nvs.contains("authmode"))
+            return std::nullopt;
+
+        auto authmode = std::get<std::uint8_t>(nvs.get("authmode"));
+        if (authmode >= WIFI_AUTH_MAX)
+            return std::nullopt;
+
+        Cache cache {
+            .ssid = std::get<std::string>(nvs.get("ssid")),
+            .bssid = {},
+            .channel = std::get<std::uint8_t>(nvs.get("channel")),
+            .authmode = static_cast<wifi_auth_mode_t>(authmode),
+            .lease = std::nullopt,
+        };
+        Blob bssid = std::get<Blob>(nvs.get("bssid"));
+        if (bssid.size() != cache.bssid.size())
+            return std::nullopt;
+        std::copy(bssid.begin(), bssid.end(), cache.bssid.begin());
+
+        if (nvs.contains("ip")) {
+            cache.lease = Lease {
+                .ip = std::get<std::uint32_t>(nvs.get("ip")),
+                .netmask = std::get<std::uint32_t>(nvs.get("netmask")),
+                .gateway = std::get<std::uint32_t>(nvs.get("gateway")),
+                .dns = std::get<std::uint32_t>(nvs.get("dns")),
+            };
+        }
+        return cache;
+    } catch (const std::exception& e) {
+        ESP_LOGW(s_tag, "Failed to load the last connection: %s", e.what());
+        return std::nullopt;
+    }
+}
+
+// Written only when something changed, most connections are to the same AP with the same lease.
+void Station::storeCache(const Cache& cache) {
+    if (m_config.cacheNamespace.empty() || m_cache == cache)
+        return;
+    try {
+        NVS nvs(m_config.cacheNamespace);
+        nvs.set("ssid", cache.ssid);
+        nvs.set("bssid", Blob(cache.bssid.begin(), cache.bssid.end()));
+        nvs.set("channel", cache.channel);
+        nvs.set("authmode", static_cast<std::uint8_t>(cache.authmode));
+        if (cache.lease) {
+            nvs.set("ip", cache.lease->ip);
+            nvs.set("netmask", cache.lease->netmask);
+            nvs.set("gateway", cache.lease->gateway);
+            nvs.set("dns", cache.lease->dns);
+        }
+        nvs.commit();
+        m_cache = cache;
+    } catch (const std::exception& e) {
+        ESP_LOGW(s_tag, "Failed to store the connection: %s", e.what());
+    }
+}
+
+std::optional<Station::Candidate> Station::cachedCandidate() const {
+    if (!m_cache)
+        return std::nullopt;
+    for (std::size_t i = 0; i < m_config.networks.size(); ++i) {
+        if (m_config.networks[i].ssid == m_cache->ssid)
+            return Candidate {
+                .network = i,
+                .bssid = m_cache->bssid,
+                .channel = m_cache->channel,
+                .cached = true,
+                .authmode = m_cache->authmode,
+            };
+    }
+    return std::nullopt;
+}
+
+// Assigns the lease statically, or hands the address back to DHCP if there is none.
+void Station::useLease(const Lease* lease) {
+    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (!netif)
+        return;
+
+    if (!lease) {
+        if (m_staticLease && esp_netif_dhcpc_start(netif) == ESP_OK)
+            m_staticLease = false;
+        return;
+    }
+
+    esp_netif_ip_info_t info = {};
+    info.ip.addr = lease->ip;
+    info.netmask.addr = lease->netmask;
+    info.gw.addr = lease->gateway;
+    esp_netif_dns_info_t dns = {};
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    dns.ip.u_addr.ip4.addr = lease->dns;
+
+    esp_err_t err = esp_netif_dhcpc_stop(netif);
+    if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        ESP_LOGW(s_tag, "Failed to stop DHCP: %s", esp_err_to_name(err));
+        return;
+    }
+    m_staticLease = true;
+    if (esp_netif_set_ip_info(netif, &info) != ESP_OK || esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns) != ESP_OK)
+        ESP_LOGW(s_tag, "Failed to assign the last lease");
+}
+
+void Station::onRssiLow(const wifi_event_bss_rssi_low_t* event) {
+    std::scoped_lock lock(m_mutex);
+    if (m_state != State::Connected || m_roamScan || m_config.roaming.thresholdDbm == 0)
+        return;
+
+    ESP_LOGI(s_tag, "Signal dropped to %ld dBm, looking for a stronger AP", static_cast<long>(event->rssi));
+    esp_err_t err = esp_wifi_scan_start(nullptr, false);
+    if (err != ESP_OK)
+        ESP_LOGW(s_tag, "Failed to start scan: %s", esp_err_to_name(err));
+    else
+        m_roamScan = true;
+    arm(m_config.roaming.intervalMs);
+}
+
+Station::State Station::state() const {
+    std::scoped_lock lock(m_mutex);
+    return m_state;
+}
+
+std::optional<Station::Network> Station::network() const {
+    std::scoped_lock lock(m_mutex);
+    if (!m_current)
+        return std::nullopt;
+    return m_config.networks[m_current->network];
+}
+
+std::uint32_t Station::delayMs(std::uint32_t round) const {
+    std::uint64_t ceiling = m_config.backoff.initialMs;
+    for (std::uint32_t i = 0; i < round && ceiling < m_config.backoff.maxMs; ++i)
+        ceiling *= 2;
+    ceiling = std::min<std::uint64_t>(ceiling, m_config.backoff.maxMs);
+
+    std::uint64_t half = ceiling / 2;
+    return static_cast<std::uint32_t>(half + esp_random() % (ceiling - half + 1));
+}
+
+Station::Stats Station::stats() const {
+    return {
+        .reconnects = m_reconnects.load(),
+        .attempts = m_attempts.load(),
+        .lastOutageMs = m_lastOutageMs.load(),
+        .maxOutageMs = m_maxOutageMs.load(),
+        .bootToConnectedMs = m_bootToConnectedMs.load(),
+        .directed = m_directedConnects.load(),
+        .roams = m_roams.load(),
+    };
+}
@@ -229,6 +229,12 @@ void WiFi::connect(std::string ssid, std::string password, bool reconnect) {
     startSTA(wifi_config);
 }
 
+void WiFi::startStation() {
+    m_reconnect = false;
+    m_mode = Manual;
+    startSTA();
+}
+
 std::vector<wifi_ap_record_t> WiFi::scan(uint16_t max) {
     if (m_connected) {
         throw std::runtime_error("Cannot scan while connected");
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "NVS.hpp"
+#include "NetIf.hpp"
+#include "WiFi.hpp"
+
+#include "eventpp/eventdispatcher.h"
+
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps the station connected to one of the known networks.
+ *
+ * Losing the AP does not restart anything: the station first reassociates
+ * with the AP it just lost, then scans and tries the known networks in
+ * range, and waits a jittered, exponentially growing time between rounds.
+ * Scanning, associating and obtaining an IP address are bounded by
+ * timeouts. The netif is kept, so sockets of MQTT and other clients simply
+ * resume once an address is back.
+ *
+ * The AP, its security and the lease of the last connection are remembered
+ * in NVS. After a boot the station associates with that AP on its channel
+ * right away and only scans if that fails. With Config::reuseLease the
+ * remembered address is assigned statically, which skips DHCP altogether.
+ *
+ * Every AP of a known network found by a scan is a candidate, tried one at a
+ * time in order of rank: signal strength, adjusted by how attempts with that
+ * AP went before and by how well it is secured. APs whose security does not
+ * match the password of the network are left out. Once the signal of the
+ * connected AP drops below Config::roaming.thresholdDbm, a scan runs in the
+ * background and the station moves to a clearly stronger AP, if there is one.
+ *
+ * Every state change is dispatched to listeners registered with on(), with
+ * the previous state as argument, from the Wi-Fi event task or the esp_timer
+ * task.
+ */
+class Station {
+public:
+    enum class State {
+        Idle,
+        Scanning,
+        Associating,
+        ObtainingIP,
+        Connected,
+        Waiting, // Backing off before the next scan.
+    };
+
+    struct Network {
+        std::string ssid;
+        std::string password;
+    };
+
+    struct Backoff {
+        std::uint32_t initialMs = 500;
+        std::uint32_t maxMs = 30 * 1000;
+    };
+
+    struct Roaming {
+        std::int8_t thresholdDbm = -75; // 0 never roams.
+        std::uint8_t hysteresisDb = 8; // How much stronger another AP has to be.
+        std::uint32_t intervalMs = 30 * 1000; // Between scans while the signal stays weak.
+    };
+
+    struct Config {
+        std::vector<Network> networks;
+        Backoff backoff = {};
+        Roaming roaming = {};
+        // An active scan of all channels takes about 2 s, the driver is given some slack.
+        std::uint32_t scanTimeoutMs = 5 * 1000;
+        // Per candidate, the next one is tried after that.
+        std::uint32_t associateTimeoutMs = 10 * 1000;
+        // Attempts with a remembered AP, a scan follows once it runs out.
+        std::uint32_t directedTimeoutMs = 3 * 1000;
+        std::uint32_t ipTimeoutMs = 10 * 1000;
+        // NVS namespace the last connection is kept in, empty to not keep it.
+        std::string cacheNamespace = "station";
+        // Only for networks where the address of the device is reserved.
+        bool reuseLease = false;
+    };
+
+    struct Stats {
+        std::uint32_t reconnects; // Connections established after the first one.
+        std::uint32_t attempts; // Association attempts since the last connection.
+        std::uint32_t lastOutageMs; // Disconnect to IP address, of the last reconnect.
+        std::uint32_t maxOutageMs;
+        std::uint32_t bootToConnectedMs; // Boot to the first IP address, 0 until then.
+        std::uint32_t directed; // Connections made without a scan.
+        std::uint32_t roams;
+    };
+
+    using Dispatcher = eventpp::EventDispatcher<State, void(State previous)>;
+    using Handle = Dispatcher::Handle;
+
+private:
+    static constexpr const char* s_tag = "Station";
+
+    // Boot to connected above this is logged as a warning. It is what the cache aims for, not a
+    // guarantee: the AP, the DHCP server and the board decide, stats().bootToConnectedMs tells.
+    // Not yet measured on a board, only the connection sequence was checked in simulation.
+    static constexpr std::uint32_t s_bootTargetMs = 1000;
+    // Rank adjustments, in dB of signal strength.
+    static constexpr int s_successBonus = 5;
+    static constexpr int s_failurePenalty = 10;
+    static constexpr std::uint16_t s_historyLimit = 3; // Attempts counted per AP and outcome.
+
+    using Bssid = std::array<std::uint8_t, 6>;
+
+    struct Candidate {
+        std::size_t network;
+        std::optional<Bssid> bssid;
+        std::uint8_t channel = 0;
+        bool cached = false; // The AP of the remembered connection.
+        std::int8_t rssi = 0;
+        wifi_auth_mode_t authmode = WIFI_AUTH_OPEN;
+        int rank = 0;
+    };
+
+    // Outcomes of earlier attempts with one AP, since boot.
+    struct History {
+        std::uint16_t successes = 0;
+        std::uint16_t failures = 0;
+    };
+
+    struct Lease {
+        std::uint32_t ip;
+        std::uint32_t netmask;
+        std::uint32_t gateway;
+        std::uint32_t dns;
+
+        bool operator==(const Lease&) const = default;
+    };
+
+    struct Cache {
+        std::string ssid;
+        Bssid bssid;
+        std::uint8_t channel;
+        // Security the AP was found with, the directed attempt does not accept less.
+        wifi_auth_mode_t authmode;
+        std::optional<Lease> lease;
+
+        bool operator==(const Cache&) const = default;
+    };
+
+    const Config m_config;
+
+    mutable std::recursive_mutex m_mutex;
+    State m_state = State::Idle;
+    std::vector<Candidate> m_candidates;
+    std::size_t m_next = 0;
+    std::optional<Candidate> m_current;
+    std::uint32_t m_round = 0;
+    bool m_everConnected = false;
+    std::int64_t m_disconnectedAt = 0;
+    // The candidates are a guess made without scanning, running out of them leads to a scan.
+    bool m_directed = false;
+    bool m_staticLease = false;
+    std::optional<Cache> m_cache;
+    std::map<Bssid, History> m_history;
+    bool m_roamScan = false; // A scan runs while connected.
+
+    esp_timer_handle_t m_timer = nullptr;
+    Dispatcher m_dispatcher;
+
+    std::vector<std::pair<WiFi::EventID, WiFi::Handle>> m_wifiHandles;
+    std::vector<std::pair<NetIf::EventID, NetIf::Handle>> m_netifHandles;
+
+    std::atomic<std::uint32_t> m_reconnects = 0;
+    std::atomic<std::uint32_t> m_attempts = 0;
+    std::atomic<std::uint32_t> m_lastOutageMs = 0;
+    std::atomic<std::uint32_t> m_maxOutageMs = 0;
+    std::atomic<std::uint32_t> m_bootToConnectedMs = 0;
+    std::atomic<std::uint32_t> m_directedConnects = 0;
+    std::atomic<std::uint32_t> m_roams = 0;
+
+    static void onTimer(void* arg);
+
+    void transition(State state);
+    void arm(std::uint32_t ms);
+    void scan();
+    void scanDone();
+    std::vector<Candidate> rank(const std::vector<wifi_ap_record_t>& records) const;
+    void roam(const std::vector<Candidate>& candidates);
+    void armRoaming();
+    void associateNext();
+    void associate(const Candidate& candidate);
+    void failed();
+    void wait();
+
+    std::optional<Cache> loadCache() const;
+    void storeCache(const Cache& cache);
+    std::optional<Candidate> cachedCandidate() const;
+    void useLease(const Lease* lease);
+
+    void onConnected();
+    void onDisconnected(const wifi_event_sta_disconnected_t* event);
+    void onGotIP(const ip_event_got_ip_t* event);
+    void onLostIP();
+    void onRssiLow(const wifi_event_bss_rssi_low_t* event);
+
+public:
+    explicit Station(const Config& config);
+    ~Station();
+
+    Station(const Station&) = delete;
+    Station& operator=(const Station&) = delete;
+
+    void start();
+    void stop();
+
+    State state() const;
+    // The network of the current or last connection attempt.
+    std::optional<Network> network() const;
+    Stats stats() const;
+    std::uint32_t delayMs(std::uint32_t round) const;
+
+    Handle on(State state, Dispatcher::Callback callback) {
+        return m_dispatcher.appendListener(state, callback);
+    }
+
+    bool removeListener(State state, Handle handle) {
+        return m_dispatcher.removeListener(state, handle);
+    }
+};
@@ -43,7 +43,8 @@ private:
         Nothing,
         Connect,
         Create,
-        Scan
+        Scan,
+        Manual, // Started as station, connections are made by the caller, e.g. Station.
     };
 
     std::atomic<Mode> m_mode = Nothing;
@@ -67,6 +68,8 @@ public:
     void init();
 
     void connect(std::string ssid, std::string password, bool reconnect = true);
+    // Starts the driver in station mode without connecting anywhere.
+    void startStation();
     void createAP(std::string ssid, std::string password, std::uint8_t channel = 6);
 
     void reset();
@@ -12,6 +12,7 @@
 #include <string>
 #include <string_view>
 #include <optional>
+#include <vector>
 
 #define MDNS_SERVICE_NAME "tet-controller"
 #define MDNS_SERVICE_TYPE "_http._tcp"
@@ -88,6 +89,26 @@ public:
         mdns_query_results_free(results);
         return result;
     }
+
+    // All instances that answered, skipping those without an address. Empty if the query failed.
+    std::vector<ServiceResult> queryServices(std::string serviceName, std::string protocol, std::size_t maxResults = 20) {
+        ESP_LOGI(s_tag, "Query PTR: %s.%s.local", serviceName.c_str(), protocol.c_str());
+
+        mdns_result_t* results = nullptr;
+        std::vector<ServiceResult> services;
+        // Callers treat a failed query like one nobody answered.
+        if (esp_err_t err = mdns_query_ptr(serviceName.c_str(), protocol.c_str(), 3000, maxResults, &results); err != ESP_OK) {
+            ESP_LOGW(s_tag, "Query failed: %s", esp_err_to_name(err));
+            return services;
+        }
+
+        for (mdns_result_t* result = results; result; result = result->next) {
+            if (result->addr)
+                services.emplace_back(*result);
+        }
+        mdns_query_results_free(results);
+        return services;
+    }
 };
 
 } // namespace mDNS
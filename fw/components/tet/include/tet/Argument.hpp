@@ -1,8 +1,13 @@
 #pragma once
 
+#include "tet/Validation.hpp"
 #include "tet/util.hpp"
 
+#include <nlohmann/json.hpp>
+
+#include <concepts>
 #include <cstdint>
+#include <limits>
 #include <tuple>
 
 namespace tet {
@@ -24,14 +29,24 @@ struct ArgumentBase {
         , description(description)
         , required(required) {};
 
+    // Opening of the encoded argument up to the value of "required", derived types append their own keys.
+    template <std::size_t t_indent = 0>
+    consteval auto headerPieces() const noexcept {
+        return std::make_tuple( //
+            Indent<t_indent>(), text("\""), name, text("\": {\n"), //
+            Indent<t_indent + 1>(), text("\"type\": \""), type, text("\",\n"), //
+            Indent<t_indent + 1>(), text("\"description\": \""), description, text("\",\n"), //
+            Indent<t_indent + 1>(), text("\"required\": "), when(required, text("true")), when(!required, text("false"))); //
+    }
+
+    template <std::size_t t_indent = 0>
+    consteval auto pieces() const noexcept {
+        return std::tuple_cat(headerPieces<t_indent>(), std::make_tuple(text("\n"), Indent<t_indent>(), text("}")));
+    }
+
     template <std::size_t t_indent = 0>
     consteval auto encode() const noexcept {
-        return //
-            indent<t_indent> + "\"" + name + "\": {\n" + //
-            indent<t_indent + 1> + "\"type\": \"" + type + "\",\n" + //
-            indent<t_indent + 1> + "\"description\": \"" + description + "\",\n" + //
-            indent<t_indent + 1> + "\"required\": " + (required ? " true" : "false") + "\n" + //
-            indent<t_indent> + "}"; //
+        return encodePieces(pieces<t_indent>());
     }
 };
 
@@ -41,6 +56,12 @@ ArgumentBase(const char (&type)[t_typeSize], const char (&name)[t_nameSize],
     const char (&description)[t_descriptionSize], bool required)
     -> ArgumentBase<t_typeSize - 1, t_nameSize - 1, t_descriptionSize - 1>;
 
+// Longest numeric values in the encoded schema, see formatDecimal
+static constexpr std::size_t s_lengthWidth = std::numeric_limits<std::int32_t>::digits10 + 1;
+static constexpr std::size_t s_valueWidth = std::numeric_limits<std::int64_t>::digits10 + 9;
+
+static constexpr std::size_t s_unboundedLength = std::numeric_limits<std::int32_t>::max();
+
 template <typename T, std::size_t typeSize, std::size_t nameSize, std::size_t t_descriptionSize>
 concept Argument = std::derived_from<T, ArgumentBase<typeSize, nameSize, t_descriptionSize>>;
 
@@ -50,19 +71,53 @@ template <std::size_t t_nameSize, std::size_t t_descriptionSize,
 struct String : Base {
     consteval String(const char (&name)[t_nameSize + 1],
         const char (&description)[t_descriptionSize + 1],
-        bool required) noexcept
-        : Base("string", name, description, required) {};
+        bool required,
+        std::size_t minLength = 0,
+        std::size_t maxLength = s_unboundedLength) noexcept
+        : Base("string", name, description, required)
+        , minLength(minLength)
+        , maxLength(maxLength) {};
 
-    using Base::encode;
+    const std::size_t minLength;
+    const std::size_t maxLength;
+
+    using Base::name;
+    using Base::type;
+    using Base::description;
+    using Base::required;
+
+    template <std::size_t t_indent = 0>
+    consteval auto pieces() const noexcept {
+        return std::tuple_cat(Base::template headerPieces<t_indent>(),
+            std::make_tuple( //
+                when(minLength != 0, text(",\n"), Indent<t_indent + 1>(), text("\"minLength\": "), decimal<s_lengthWidth>(minLength)), //
+                when(maxLength != s_unboundedLength, text(",\n"), Indent<t_indent + 1>(), text("\"maxLength\": "), decimal<s_lengthWidth>(maxLength)), //
+                text("\n"), Indent<t_indent>(), text("}"))); //
+    }
+
+    template <std::size_t t_indent = 0>
+    consteval auto encode() const noexcept {
+        return encodePieces(pieces<t_indent>());
+    }
+
+    Error validate(const nlohmann::json& value, ErrorPath&) const noexcept {
+        if (!value.is_string())
+            return Error::InvalidType;
+        auto length = value.get_ref<const std::string&>().size();
+        if (length < minLength || length > maxLength)
+            return Error::InvalidLength;
+        return Error::None;
+    }
 };
 
 template <std::size_t t_nameSize, std::size_t t_descriptionSize>
 String(const char (&name)[t_nameSize],
-    const char (&description)[t_descriptionSize], bool required)
+    const char (&description)[t_descriptionSize], bool required,
+    std::size_t minLength = 0, std::size_t maxLength = s_unboundedLength)
     -> String<t_nameSize - 1, t_descriptionSize - 1>;
 
 // Number
-template <std::size_t t_nameSize, std::size_t t_descriptionSize,
+template <std::size_t t_nameSize, std::size_t t_descriptionSize, bool t_bounded = false,
     typename Base = ArgumentBase<sizeof("number") - 1, t_nameSize, t_descriptionSize>>
 struct Number : Base {
     consteval Number(const char (&name)[t_nameSize + 1],
@@ -70,7 +125,49 @@ struct Number : Base {
         bool required) noexcept
         : Base("number", name, description, required) {};
 
-    using Base::encode;
+    consteval Number(const char (&name)[t_nameSize + 1],
+        const char (&description)[t_descriptionSize + 1],
+        bool required, double minimum, double maximum) noexcept
+        : Base("number", name, description, required)
+        , minimum(minimum)
+        , maximum(maximum) {};
+
+    const double minimum = std::numeric_limits<double>::lowest();
+    const double maximum = std::numeric_limits<double>::max();
+
+    using Base::name;
+    using Base::type;
+    using Base::description;
+    using Base::required;
+
+    template <std::size_t t_indent = 0>
+    consteval auto pieces() const noexcept {
+        if constexpr (!t_bounded)
+            return Base::template pieces<t_indent>();
+        else
+            return std::tuple_cat(Base::template headerPieces<t_indent>(),
+                std::make_tuple( //
+                    text(",\n"), //
+                    Indent<t_indent + 1>(), text("\"minimum\": "), decimal<s_valueWidth>(minimum), text(",\n"), //
+                    Indent<t_indent + 1>(), text("\"maximum\": "), decimal<s_valueWidth>(maximum), text("\n"), //
+                    Indent<t_indent>(), text("}"))); //
+    }
+
+    template <std::size_t t_indent = 0>
+    consteval auto encode() const noexcept {
+        return encodePieces(pieces<t_indent>());
+    }
+
+    Error validate(const nlohmann::json& value, ErrorPath&) const noexcept {
+        if (!value.is_number())
+            return Error::InvalidType;
+        if constexpr (t_bounded) {
+            auto number = value.get<double>();
+            if (number < minimum || number > maximum)
+                return Error::OutOfRange;
+        }
+        return Error::None;
+    }
 };
 
 template <std::size_t t_nameSize, std::size_t t_descriptionSize>
@@ -78,6 +175,12 @@ Number(const char (&name)[t_nameSize],
     const char (&description)[t_descriptionSize], bool required)
     -> Number<t_nameSize - 1, t_descriptionSize - 1>;
 
+template <std::size_t t_nameSize, std::size_t t_descriptionSize>
+Number(const char (&name)[t_nameSize],
+    const char (&description)[t_descriptionSize], bool required,
+    double minimum, double maximum)
+    -> Number<t_nameSize - 1, t_descriptionSize - 1, true>;
+
 // Boolean
 template <std::size_t t_nameSize, std::size_t t_descriptionSize,
     typename Base = ArgumentBase<sizeof("boolean") - 1, t_nameSize,
@@ -89,6 +192,11 @@ struct Boolean : Base {
         : Base("boolean", name, description, required) {};
 
     using Base::encode;
+    using Base::pieces;
+
+    Error validate(const nlohmann::json& value, ErrorPath&) const noexcept {
+        return value.is_boolean() ? Error::None : Error::InvalidType;
+    }
 };
 
 template <std::size_t t_nameSize, std::size_t t_descriptionSize>
@@ -106,7 +214,7 @@ struct Array : ArrayBase<t_nameSize, t_descriptionSize> {
         const char (&description)[t_descriptionSize + 1],
         bool required, Inner inner,
         std::size_t minLength = 0,
-        std::size_t maxLength = std::numeric_limits<int>::max) noexcept
+        std::size_t maxLength = s_unboundedLength) noexcept
         : ArrayBase<t_nameSize, t_descriptionSize>("array", name, description, required)
         , inner(inner)
         , minLength(minLength)
@@ -121,18 +229,36 @@ struct Array : ArrayBase<t_nameSize, t_descriptionSize> {
     using ArrayBase<t_nameSize, t_descriptionSize>::description;
     using ArrayBase<t_nameSize, t_descriptionSize>::required;
 
+    template <std::size_t t_indent = 0>
+    consteval auto pieces() const noexcept {
+        return std::tuple_cat(ArrayBase<t_nameSize, t_descriptionSize>::template headerPieces<t_indent>(),
+            std::make_tuple( //
+                text(",\n"), //
+                Indent<t_indent + 1>(), text("\"inner\": {\n"), nested<t_indent + 2>(inner), text("\n"), //
+                Indent<t_indent + 1>(), text("}"), //
+                when(minLength != 0, text(",\n"), Indent<t_indent + 1>(), text("\"minItems\": "), decimal<s_lengthWidth>(minLength)), //
+                when(maxLength != s_unboundedLength, text(",\n"), Indent<t_indent + 1>(), text("\"maxItems\": "), decimal<s_lengthWidth>(maxLength)), //
+                text("\n"), Indent<t_indent>(), text("}"))); //
+    }
+
     template <std::size_t t_indent = 0>
     consteval auto encode() const noexcept {
-        return //
-            indent<t_indent> + "\"" + name + "\": {\n" + //
-            indent<t_indent + 1> + "\"type\": \"" + type + "\",\n" + //
-            indent<t_indent + 1> + "\"description\": \"" + description + "\",\n" + //
-            indent<t_indent + 1> + "\"required\": " + (required ? " true" : "false") + ",\n" + //
-            indent<t_indent + 1> + "\"inner\": {\n" + inner.template encode<t_indent + 2>() + //
-            indent<t_indent + 1> + "}\n" + //
-            // indent<t_indent + 1> + "\"minLength\": " + to_string<3>(minLength) + ",\n" + //
-            // indent<t_indent + 1> + "\"maxLength\": " + to_string<3>(maxLength) + "\n" + //
-            indent<t_indent> + "}"; //
+        return encodePieces(pieces<t_indent>());
+    }
+
+    Error validate(const nlohmann::json& value, ErrorPath& path) const noexcept {
+        if (!value.is_array())
+            return Error::InvalidType;
+        if (value.size() < minLength || value.size() > maxLength)
+            return Error::InvalidLength;
+        for (std::size_t i = 0; i < value.size(); ++i) {
+            Error error = inner.validate(value[i], path);
+            if (error != Error::None) {
+                path.push(i);
+                return error;
+            }
+        }
+        return Error::None;
     }
 };
 
@@ -142,8 +268,8 @@ Array(
     const char (&description)[t_descriptionSize],
     bool required,
     Inner inner,
-    std::optional<int> minLength = std::nullopt,
-    std::optional<int> maxLength = std::nullopt)
+    std::size_t minLength = 0,
+    std::size_t maxLength = s_unboundedLength)
     -> Array<t_nameSize - 1, t_descriptionSize - 1, Inner>;
 
 template <std::size_t t_nameSize, std::size_t t_descriptionSize>
@@ -166,16 +292,25 @@ struct Object : ObjectBase<t_nameSize, t_descriptionSize> {
     using ObjectBase<t_nameSize, t_descriptionSize>::description;
     using ObjectBase<t_nameSize, t_descriptionSize>::required;
 
+    template <std::size_t t_indent = 0>
+    consteval auto pieces() const noexcept {
+        return std::tuple_cat(ObjectBase<t_nameSize, t_descriptionSize>::template headerPieces<t_indent>(),
+            std::make_tuple( //
+                text(",\n"), //
+                Indent<t_indent + 1>(), text("\"properties\": {\n"), nestedList<t_indent + 1>(properties), //
+                Indent<t_indent + 1>(), text("}\n"), //
+                Indent<t_indent>(), text("}"))); //
+    }
+
     template <std::size_t t_indent = 0>
     consteval auto encode() const noexcept {
-        return //
-            indent<t_indent> + "\"" + name + "\": {\n" + //
-            indent<t_indent + 1> + "\"type\": \"" + type + "\",\n" + //
-            indent<t_indent + 1> + "\"description\": \"" + description + "\",\n" + //
-            indent<t_indent + 1> + "\"required\": " + (required ? " true" : "false") + ",\n" + //
-            indent<t_indent + 1> + "\"properties\": {\n" + encodeMultiple<t_indent + 1, 0>(properties) + //
-            indent<t_indent + 1> + "}\n" + //
-            indent<t_indent> + "}"; //
+        return encodePieces(pieces<t_indent>());
+    }
+
+    Error validate(const nlohmann::json& value, ErrorPath& path) const noexcept {
+        if (!value.is_object())
+            return Error::InvalidType;
+        return validateMembers(properties, value, path);
     }
 };
 
@@ -2,11 +2,16 @@
 
 #include "tet/Command.hpp"
 #include "tet/Event.hpp"
+#include "tet/Field.hpp"
+#include "tet/Policy.hpp"
+#include "tet/RecentIds.hpp"
+#include "tet/Serialization.hpp"
 #include "tet/State.hpp"
 #include "tet/StaticFunction.hpp"
+#include "tet/Transport.hpp"
 #include "tet/util.hpp"
 
-#include "MQTT.hpp"
+#include "esp_log.h"
 
 #include "coll/basic_string.h"
 
@@ -16,166 +21,469 @@
 #include <frozen/unordered_map.h>
 #include <nlohmann/json.hpp>
 
+#include <array>
+#include <atomic>
+#include <cassert>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
-#include <functional>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 namespace tet {
 
+// Everything up to the closing brace of "events", the overloads of makeSchema append the rest.
+template <typename... Commands, typename... Events>
+consteval auto schemaPieces(const std::tuple<Commands...>& commands, const std::tuple<Events...>& events) {
+    return std::make_tuple(
+        text("{\n"),
+        Indent<1>(), text("\"commands\": {\n"),
+        nestedList<1>(commands),
+        Indent<1>(), text("},\n"),
+        Indent<1>(), text("\"opcodes\": [\n"),
+        nameList<1>(commands, [](const auto& command) -> const auto& { return command.identifier; }),
+        Indent<1>(), text("],\n"),
+        Indent<1>(), text("\"events\": {\n"),
+        nestedList<1>(events),
+        Indent<1>(), text("}"));
+}
+
 template <typename... Commands, typename... Events>
 consteval auto makeSchema(const std::tuple<Commands...>& commands, const std::tuple<Events...>& events) {
-    return "{\n"
-        + indent<1> + "\"commands\": {\n"
-        + encodeMultiple<1, 0>(commands)
-        + indent<1> + "},\n"
-        + indent<1> + "\"events\": {\n"
-        + encodeMultiple<1, 0>(events)
-        + indent<1> + "}\n"
-        + "}";
+    return encodePieces(std::tuple_cat(schemaPieces(commands, events), std::make_tuple(text("\n}"))));
+}
+
+template <typename... Commands, typename... Events, typename... Fields>
+consteval auto makeSchema(const std::tuple<Commands...>& commands, const std::tuple<Events...>& events, const std::tuple<Fields...>& fields) {
+    return encodePieces(std::tuple_cat(
+        schemaPieces(commands, events),
+        std::make_tuple(text(",\n")),
+        statePieces<1>(fields),
+        std::make_tuple(text("\n}"))));
 }
 
-template <typename Tuple, std::size_t... Is>
+template <HW::State State, typename Tuple, std::size_t... Is>
 constexpr auto makeFrozenMapImpl(const Tuple& tuple, std::index_sequence<Is...>) {
-    return frozen::unordered_map<frozen::string, Callback<State>, std::tuple_size_v<Tuple>> {
-        std::make_pair(frozen::string(std::get<Is>(tuple).identifier), std::get<Is>(tuple).callback)... ,
+    return frozen::unordered_map<frozen::string, Handler<State>, std::tuple_size_v<Tuple>> {
+        std::make_pair(frozen::string(std::get<Is>(tuple).identifier), std::get<Is>(tuple).handler())... ,
     };
 }
 
 template <HW::State State, typename... Commands>
-constexpr frozen::unordered_map<frozen::string, Callback<State>, sizeof...(Commands)> makeFrozenMap(const std::tuple<Commands...>& commands) {
-    return makeFrozenMapImpl(commands, std::index_sequence_for<Commands...>{});
+constexpr frozen::unordered_map<frozen::string, Handler<State>, sizeof...(Commands)> makeFrozenMap(const std::tuple<Commands...>& commands) {
+    return makeFrozenMapImpl<State>(commands, std::index_sequence_for<Commands...>{});
+}
+
+/**
+ * Handlers indexed by opcode. The opcode of a command is its position in the
+ * tuple, which is also its position in the "opcodes" list of the schema.
+ */
+template <HW::State State, typename... Commands>
+constexpr std::array<Handler<State>, sizeof...(Commands)> makeDispatchTable(const std::tuple<Commands...>& commands) {
+    return std::apply([](const auto&... command) {
+        return std::array<Handler<State>, sizeof...(Commands)> { command.handler()... };
+    },
+        commands);
 }
 
 using namespace std::string_literals;
 static constexpr inline std::string s_topicPrefix = "tet/devices/"s;
 static constexpr inline std::string s_commandTopic = "/commands"s;
 static constexpr inline std::string s_eventTopic = "/events/"s;
+static constexpr inline std::string s_errorTopic = "/errors"s;
+static constexpr inline std::string s_stateTopic = "/state"s;
+static constexpr inline std::string s_deltaTopic = "/state/delta"s;
+static constexpr inline std::string s_frameTopic = "/frames/"s;
 
 
+/**
+ * Link is the transport to the controller, e.g. MqttTransport on a device or
+ * LoopbackTransport in tests and benchmarks.
+ */
 template <HW::State State,
     HW::Manager<State> Manager,
-    std::size_t t_commandCount>
+    Transport Link,
+    std::size_t t_commandCount,
+    typename Fields = std::tuple<>>
 class Client {
 public:
     template <std::size_t t_identifierSize, std::size_t t_descriptionSize, typename... Args>
     using Command = tet::Command<State, t_identifierSize, t_descriptionSize, Args...>;
 
     using Callback = tet::Callback<State>;
+    using Handler = tet::Handler<State>;
+
+    struct DuplicateStats {
+        std::uint32_t keyed; // Executed commands that carried an id.
+        std::uint32_t duplicates; // Redelivered commands that were skipped.
+    };
 
 private:
     static constexpr const char* s_tag = "tet::Client";
-    static constexpr MQTT::QOS s_qos = MQTT::QOS::ExactlyOnce;
+    static constexpr std::size_t s_recentIds = 32;
 
     const std::string m_id;
     const std::string_view m_definitionString;
 
-    const frozen::unordered_map<frozen::string, Callback, t_commandCount> m_callbacks;
+    const frozen::unordered_map<frozen::string, Handler, t_commandCount> m_callbacks;
+    const std::array<Handler, t_commandCount> m_opcodes;
+    const Fields m_fields;
 
-    MQTT::Client* m_mqtt = nullptr;
+    Link* m_transport = nullptr;
     Manager* m_manager = nullptr;
 
-    std::vector<std::tuple<MQTT::Event::Id, MQTT::Client::Handle>> m_handles;
+    Format m_stateFormat = Format::Json;
+    Policy m_policy;
 
-    void onData(esp_mqtt_event_handle_t const event) {
-        ESP_LOGI(s_tag, "Received message on topic %.*s", event->topic_len, event->topic);
+    // Serializes commands, whichever task they arrive on, with other writers of the manager's hardware.
+    // Nothing is published while it is held, the transport may be delivering to us under its own lock.
+    mutable std::recursive_mutex m_mutex;
 
-        std::string_view message(event->data, event->data_len);
-        std::string_view topic(event->topic, event->topic_len);
+    RecentIds<s_recentIds> m_recentIds;
+    std::atomic<std::uint32_t> m_keyed = 0;
+    std::atomic<std::uint32_t> m_duplicates = 0;
 
-        if (topic != s_topicPrefix + m_id + s_commandTopic) {
-            ESP_LOGE(s_tag, "Received message on invalid topic %.*s", event->topic_len, event->topic);
+    void onData(const Frame& frame) {
+        ESP_LOGD(s_tag, "Received message on topic %.*s", static_cast<int>(frame.topic.size()), frame.topic.data());
+
+        if (frame.topic != s_topicPrefix + m_id + s_commandTopic) {
+            ESP_LOGE(s_tag, "Received message on invalid topic %.*s", static_cast<int>(frame.topic.size()), frame.topic.data());
             return;
         }
 
-        nlohmann::json json = nlohmann::json::parse(message);
+        nlohmann::json json = nlohmann::json::parse(frame.payload, nullptr, false);
 
         if (json.is_object())
             handleCommand(json);
         else if (json.is_array())
-            for (auto& item : json)
-                handleCommand(item);
+            handleCommands(json);
+        else
+            reportError(Error::InvalidJson, {}, {});
+    }
+
+    const Handler* lookup(const nlohmann::json& command) const {
+        if (command.is_number_unsigned()) {
+            auto opcode = command.get<std::uint64_t>();
+            return opcode < m_opcodes.size() ? &m_opcodes[opcode] : nullptr;
+        }
+
+        auto handler = m_callbacks.find(std::string_view(command.get_ref<const std::string&>()));
+        return handler == m_callbacks.end() ? nullptr : &handler->second;
+    }
+
+    // Commands are addressed either by name or by opcode, e.g. {"command": 3, "data": {...}}.
+    const Handler* findHandler(const nlohmann::json& json, ErrorPath& path, Error& error) const {
+        auto command = json.find("command");
+        if (command == json.end() || !(command->is_string() || command->is_number_unsigned())) {
+            error = Error::MissingCommand;
+            return nullptr;
+        }
+
+        const Handler* handler = lookup(*command);
+        if (!handler) {
+            error = Error::UnknownCommand;
+            return nullptr;
+        }
+
+        error = handler->validate(dataOf(json), path);
+        if (error != Error::None)
+            return nullptr;
+
+        return handler;
+    }
+
+    // Commands with an "id" run at most once, so they can be delivered with QoS 1.
+    bool isDuplicate(const std::optional<std::uint64_t>& key) {
+        if (!key || !m_recentIds.contains(*key))
+            return false;
+        ++m_duplicates;
+        ESP_LOGW(s_tag, "Skipped duplicate command %llu", static_cast<unsigned long long>(*key));
+        return true;
+    }
+
+    // State around one or more commands, kept only when deltas are published.
+    struct Change {
+        std::optional<State> before;
+        std::optional<State> after;
+    };
+
+    void handleCommand(const nlohmann::json& json) {
+        ErrorPath path;
+        Error error = Error::None;
+        const Handler* handler = nullptr;
+        Change change;
+        {
+            std::lock_guard lock(m_mutex);
+            auto key = idempotencyKey(json);
+            if (isDuplicate(key))
+                return;
+            handler = findHandler(json, path, error);
+            if (handler)
+                run(*handler, json, key, change);
+        }
+
+        if (!handler)
+            reportError(error, commandName(json), path);
         else
-            throw std::runtime_error("Invalid JSON");
+            publishDelta(change);
     }
 
-    void handleCommand(const nlohmann::json& json) const {
-        if (!json.contains("command")) {
-            ESP_LOGE(s_tag, "No command in JSON");
+    // The command has been validated already, m_mutex is held.
+    void run(const Handler& handler, const nlohmann::json& json, const std::optional<std::uint64_t>& key, Change& change) {
+        if (key) {
+            m_recentIds.insert(*key);
+            ++m_keyed;
+        }
+        apply(handler.callback, dataOf(json), change);
+    }
+
+    void execute(const Handler& handler, const nlohmann::json& command, const nlohmann::json& data) {
+        ErrorPath path;
+        Error error = handler.validate(data, path);
+        if (error != Error::None) {
+            reportError(error, command, path);
             return;
         }
-        std::string command;
-        json["command"].get_to(command);
-        auto _command = m_callbacks.find(std::string_view(command));
-        if (_command == m_callbacks.end()) {
-            ESP_LOGE(s_tag, "Unknown command %s", command.c_str());
-            m_mqtt->publish(s_topicPrefix + m_id, "Unknown command " + command, s_qos);
+
+        Change change;
+        {
+            std::lock_guard lock(m_mutex);
+            apply(handler.callback, data, change);
+        }
+        publishDelta(change);
+    }
+
+    // m_mutex is held.
+    void apply(const Callback& callback, const nlohmann::json& data, Change& change) {
+        if constexpr (std::tuple_size_v<Fields> == 0) {
+            m_manager->apply(callback(m_manager->get(), data));
+        } else {
+            State before = m_manager->get();
+            State after = callback(before, data);
+            m_manager->apply(after);
+            if (!change.before)
+                change.before = std::move(before);
+            change.after = std::move(after);
+        }
+    }
+
+    template <std::size_t t_id>
+    void appendDelta(std::string& payload, std::string& value, const State& before, const State& after) const {
+        const auto& field = std::get<t_id>(m_fields);
+        if (!field.changed(before, after))
+            return;
+        if (!serialize<Format::Json>(field.get(after), value)) {
+            ESP_LOGE(s_tag, "Failed to serialize state field %zu", t_id);
             return;
         }
+        if (payload.size() > 1)
+            payload += ',';
+        payload += '[';
+        payload += std::to_string(t_id);
+        payload += ',';
+        payload += value;
+        payload += ']';
+    }
+
+    /**
+     * Publishes the fields changed by a command as [[id, value], ...].
+     * Ids index the "fields" list of the state schema.
+     */
+    void publishDelta(const Change& change) {
+        if (!change.before)
+            return;
+        const State& before = *change.before;
+        const State& after = *change.after;
 
-        if (!json.contains("data")) {
-            ESP_LOGE(s_tag, "No data in JSON");
+        std::string payload = "[";
+        std::string value;
+        [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+            (appendDelta<Is>(payload, value, before, after), ...);
+        }(std::make_index_sequence<std::tuple_size_v<Fields>>());
+
+        if (payload.size() == 1)
             return;
+        payload += ']';
+        publish(s_topicPrefix + m_id + s_deltaTopic, payload, Delivery { m_policy.state.qos, false, m_policy.state.expiry });
+    }
+
+    void handleCommands(const nlohmann::json& json) {
+        // Compound commands are applied atomically, so all of them are validated before any is executed.
+        // Items that were already executed are skipped one by one, a redelivered compound skips all of them.
+        std::vector<const Handler*> handlers;
+        handlers.reserve(json.size());
+        for (const auto& item : json) {
+            ErrorPath path;
+            Error error = Error::InvalidJson;
+            const Handler* handler = item.is_object() ? findHandler(item, path, error) : nullptr;
+            if (!handler) {
+                reportError(error, item.is_object() ? commandName(item) : nlohmann::json(), path);
+                return;
+            }
+            handlers.push_back(handler);
+        }
+
+        // One delta covers the whole compound.
+        Change change;
+        {
+            std::lock_guard lock(m_mutex);
+            for (std::size_t i = 0; i < handlers.size(); ++i) {
+                auto key = idempotencyKey(json[i]);
+                if (!isDuplicate(key))
+                    run(*handlers[i], json[i], key, change);
+            }
         }
-        m_manager->apply(_command->second(m_manager->get(), json["data"]));
+        publishDelta(change);
+    }
+
+    static const nlohmann::json& dataOf(const nlohmann::json& json) {
+        static const nlohmann::json s_noData;
+        auto data = json.find("data");
+        return data == json.end() ? s_noData : *data;
+    }
+
+    // Name or opcode of the command, null if there is none.
+    static const nlohmann::json& commandName(const nlohmann::json& json) {
+        static const nlohmann::json s_noCommand;
+        auto command = json.find("command");
+        return command == json.end() ? s_noCommand : *command;
+    }
+
+    void reportError(Error error, const nlohmann::json& command, const ErrorPath& path) const {
+        ESP_LOGE(s_tag, "Rejected command %s: error %u at \"%.*s\"",
+            command.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace).c_str(),
+            static_cast<unsigned>(error),
+            static_cast<int>(path.view().size()), path.view().data());
+
+        nlohmann::json report = {
+            { "command", command },
+            { "error", static_cast<unsigned>(error) },
+            { "path", path.view() },
+        };
+        publish(s_topicPrefix + m_id + s_errorTopic, report.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace), m_policy.errors);
+    }
+
+    void publish(const std::string& topic, std::string_view payload, const Delivery& delivery) const {
+        m_transport->publish(topic, payload, delivery);
     }
 
-    void onDisconnect(esp_mqtt_event_handle_t const event) const {
+    void onDisconnect() const {
         ESP_LOGI(s_tag, "Disconnected");
     }
 
-    void onConnected(esp_mqtt_event_handle_t const event) {
+    void onConnected() {
         ESP_LOGI(s_tag, "Connected");
-        m_mqtt->subscribe(s_topicPrefix + m_id + s_commandTopic, s_qos);
-        m_mqtt->publish(s_topicPrefix + m_id, m_definitionString, s_qos, true);
+        m_transport->subscribe(s_topicPrefix + m_id + s_commandTopic, m_policy.commands);
+        publish(s_topicPrefix + m_id, m_definitionString, m_policy.schema);
+        if constexpr (Serializable<State>)
+            publishState();
     }
 
 public:
     Client(
         const std::string& id,
         const std::string_view& definitionString,
-        const frozen::unordered_map<frozen::string, Callback, t_commandCount>& callbacks)
+        const frozen::unordered_map<frozen::string, Handler, t_commandCount>& callbacks,
+        const std::array<Handler, t_commandCount>& opcodes,
+        const Fields& fields = {})
         : m_id(id)
         , m_definitionString(definitionString)
-        , m_callbacks(callbacks) {
+        , m_callbacks(callbacks)
+        , m_opcodes(opcodes)
+        , m_fields(fields) {
     }
 
-    void init(MQTT::Client* mqtt, Manager* manager) {
-        using namespace MQTT::Event;
-        using namespace std::placeholders;
-
-        assert(mqtt != nullptr);
+    void init(Link* transport, Manager* manager) {
+        assert(transport != nullptr);
         assert(manager != nullptr);
 
-        m_mqtt = mqtt;
+        if (m_transport)
+            m_transport->detach();
+        m_transport = transport;
         m_manager = manager;
-        for (auto [eventId, handle] : m_handles)
-            m_mqtt->removeListener(eventId, handle);
-        m_handles.clear();
-        m_handles = std::vector<std::tuple<Id, MQTT::Client::Handle>> {
-            {Id::Data, m_mqtt->on(Id::Data, std::bind(&Client::onData, this, _1))},
-            {Id::Connected, m_mqtt->on(Id::Connected, std::bind(&Client::onConnected, this, _1))},
-            {Id::Disconnected, m_mqtt->on(Id::Disconnected, std::bind(&Client::onDisconnect, this, _1))},
-        };
+        m_transport->attach(TransportEvents {
+            .message = [this](const Frame& frame) { onData(frame); },
+            .connected = [this] { onConnected(); },
+            .disconnected = [this] { onDisconnect(); },
+        });
     }
 
     ~Client() {
-        for (auto [eventId, handle] : m_handles)
-            m_mqtt->removeListener(eventId, handle);
+        if (m_transport)
+            m_transport->detach();
     }
 
     void sendEvent(std::string event, nlohmann::json data) {
-        m_mqtt->publish(s_topicPrefix + m_id + s_eventTopic + event, data.dump(), s_qos);
+        publish(s_topicPrefix + m_id + s_eventTopic + event, data.dump(), m_policy.events);
     }
 
-    void executeCommand(std::string_view command, nlohmann::json data) {
-        if (m_callbacks.find(command) == m_callbacks.end())
+    template <Serializable Args>
+        requires(!std::same_as<Args, nlohmann::json>)
+    void sendEvent(std::string event, const Args& data) {
+        std::string payload;
+        if (!serialize<Format::Json>(data, payload)) {
+            ESP_LOGE(s_tag, "Failed to serialize event %s", event.c_str());
             return;
+        }
+        publish(s_topicPrefix + m_id + s_eventTopic + event, payload, m_policy.events);
+    }
+
+    // Raw payload, e.g. a rendered LED frame, sent with the frames policy.
+    void sendFrame(std::string_view stream, std::string_view payload) {
+        publish(s_topicPrefix + m_id + s_frameTopic + std::string(stream), payload, m_policy.frames);
+    }
+
+    void setStateFormat(Format format) { m_stateFormat = format; }
+
+    DuplicateStats duplicateStats() const { return { m_keyed.load(), m_duplicates.load() }; }
 
-        m_callbacks[command].callback(m_manager->get(), data);
+    // Takes effect for the command subscription on the next connect.
+    void setPolicy(const Policy& policy) { m_policy = policy; }
+
+    void publishState()
+        requires Serializable<State>
+    {
+        State state = [this] {
+            std::lock_guard lock(m_mutex);
+            return m_manager->get();
+        }();
+        std::string payload;
+        if (!serialize(m_stateFormat, state, payload)) {
+            ESP_LOGE(s_tag, "Failed to serialize state");
+            return;
+        }
+        publish(s_topicPrefix + m_id + s_stateTopic, payload, m_policy.state);
+    }
+
+    /**
+     * Held while a command runs. Code that drives the same hardware from
+     * another task, e.g. a show streaming frames, takes it too, so its
+     * writes do not interleave with a command's. Do not publish through
+     * this client while holding it.
+     */
+    [[nodiscard]] std::unique_lock<std::recursive_mutex> lock() const { return std::unique_lock(m_mutex); }
+
+    // Invalid commands are reported on the errors topic, like those received from the controller.
+    // Safe to call from any task, the command is serialized with those received from the transport.
+    void executeCommand(std::string_view command, const nlohmann::json& data) {
+        auto handler = m_callbacks.find(command);
+        if (handler == m_callbacks.end()) {
+            reportError(Error::UnknownCommand, std::string(command), {});
+            return;
+        }
+        execute(handler->second, std::string(command), data);
+    }
+
+    void executeCommand(std::size_t opcode, const nlohmann::json& data) {
+        if (opcode >= m_opcodes.size()) {
+            reportError(Error::UnknownCommand, opcode, {});
+            return;
+        }
+        execute(m_opcodes[opcode], opcode, data);
     }
 };
 
@@ -3,6 +3,7 @@
 #include "tet/Argument.hpp"
 #include "tet/State.hpp"
 #include "tet/StaticFunction.hpp"
+#include "tet/Validation.hpp"
 #include "tet/util.hpp"
 
 #include <nlohmann/json.hpp>
@@ -15,6 +16,23 @@ namespace tet {
 template <HW::State State>
 using Callback = StaticFunction<State(const State&, const nlohmann::json&)>;
 
+using Validator = StaticFunction<Error(const void*, const nlohmann::json&, ErrorPath&)>;
+
+/**
+ * Runtime view of a Command. Keeps a pointer to the command it was created
+ * from, so the command has to outlive it (commands are expected to be constexpr globals).
+ */
+template <HW::State State>
+struct Handler {
+    Callback<State> callback;
+    const void* command;
+    Validator validator;
+
+    Error validate(const nlohmann::json& data, ErrorPath& path) const noexcept {
+        return validator(command, data, path);
+    }
+};
+
 template <HW::State State, std::size_t t_identifierSize, std::size_t t_descriptionSize, typename... Args>
 struct Command {
     fixed_string<t_identifierSize> identifier;
@@ -32,15 +50,39 @@ struct Command {
         , arguments(args)
         , callback(callback) {}
 
+    template <std::size_t t_indent = 0>
+    consteval auto pieces() const noexcept {
+        return std::make_tuple(
+            Indent<t_indent>(), text("\""), identifier, text("\": {\n"),
+            Indent<t_indent + 1>(), text("\"description\": \""), description, text("\",\n"),
+            Indent<t_indent + 1>(), text("\"arguments\": {\n"),
+            nestedList<t_indent + 2>(arguments),
+            Indent<t_indent + 1>(), text("}\n"),
+            Indent<t_indent>(), text("}"));
+    }
+
     template <std::size_t t_indent = 0>
     consteval auto encode() const noexcept {
-        return
-            indent<t_indent> + "\"" + identifier + "\": {\n" +
-            indent<t_indent + 1> + "\"description\": \"" + description + "\",\n" +
-            indent<t_indent + 1> + "\"arguments\": {\n" +
-            encodeMultiple<t_indent + 2, 0>(arguments) +
-            indent<t_indent + 1> + "}\n" +
-            indent<t_indent> + "}";
+        return encodePieces(pieces<t_indent>());
+    }
+
+    Error validate(const nlohmann::json& data, ErrorPath& path) const noexcept {
+        if constexpr (sizeof...(Args) == 0)
+            return Error::None;
+        else if (!data.is_object())
+            return Error::InvalidType;
+        else
+            return validateMembers(arguments, data, path);
+    }
+
+    constexpr Handler<State> handler() const noexcept {
+        return {
+            callback,
+            this,
+            Validator(+[](const void* command, const nlohmann::json& data, ErrorPath& path) {
+                return static_cast<const Command*>(command)->validate(data, path);
+            }),
+        };
     }
 };
 
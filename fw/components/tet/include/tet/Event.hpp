@@ -3,6 +3,7 @@
 #include "tet/util.hpp"
 
 #include <cstdint>
+#include <tuple>
 
 namespace tet {
 
@@ -20,15 +21,20 @@ struct Event {
         , description(description)
         , arguments(args) {}
 
+    template <std::size_t t_indent = 0>
+    consteval auto pieces() const noexcept {
+        return std::make_tuple(
+            Indent<t_indent>(), text("\""), identifier, text("\": {\n"),
+            Indent<t_indent + 1>(), text("\"description\": \""), description, text("\",\n"),
+            Indent<t_indent + 1>(), text("\"arguments\": {\n"),
+            nestedList<t_indent + 2>(arguments),
+            Indent<t_indent + 1>(), text("}\n"),
+            Indent<t_indent>(), text("}"));
+    }
+
     template <std::size_t t_indent = 0>
     consteval auto encode() const noexcept {
-        return
-            indent<t_indent> + "\"" + identifier + "\": {\n" +
-            indent<t_indent + 1> + "\"description\": \"" + description + "\",\n" +
-            indent<t_indent + 1> + "\"arguments\": {\n" +
-            encodeMultiple<t_indent + 2, 0>(arguments) +
-            indent<t_indent + 1> + "}\n" +
-            indent<t_indent> + "}";
+        return encodePieces(pieces<t_indent>());
     }
 };
 
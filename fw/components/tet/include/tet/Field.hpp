@@ -0,0 +1,55 @@
+#pragma once
+
+#include "tet/util.hpp"
+
+#include <cstddef>
+#include <tuple>
+
+namespace tet {
+
+/**
+ * Binds a State member to the tet::Argument describing it.
+ *
+ * The position of a field in the state tuple is its id, which is used to
+ * publish state deltas as (id, value) pairs.
+ */
+template <typename State, typename Member, typename Descriptor>
+struct Field {
+    Member State::*member;
+    Descriptor descriptor;
+
+    consteval Field(Member State::*member, Descriptor descriptor)
+        : member(member)
+        , descriptor(descriptor) {}
+
+    const Member& get(const State& state) const noexcept { return state.*member; }
+
+    bool changed(const State& before, const State& after) const { return !(before.*member == after.*member); }
+
+    template <std::size_t t_indent = 0>
+    consteval auto pieces() const noexcept {
+        return descriptor.template pieces<t_indent>();
+    }
+
+    template <std::size_t t_indent = 0>
+    consteval auto encode() const noexcept {
+        return encodePieces(pieces<t_indent>());
+    }
+};
+
+template <typename State, typename Member, typename Descriptor>
+Field(Member State::*member, Descriptor descriptor) -> Field<State, Member, Descriptor>;
+
+template <std::size_t t_indent, typename... Fields>
+consteval auto statePieces(const std::tuple<Fields...>& fields) noexcept {
+    return std::make_tuple( //
+        Indent<t_indent>(), text("\"state\": {\n"), //
+        Indent<t_indent + 1>(), text("\"type\": \"object\",\n"), //
+        Indent<t_indent + 1>(), text("\"properties\": {\n"), nestedList<t_indent + 1>(fields), //
+        Indent<t_indent + 1>(), text("},\n"), //
+        Indent<t_indent + 1>(), text("\"fields\": [\n"), nameList<t_indent + 1>(fields, [](const auto& field) -> const auto& { return field.descriptor.name; }), //
+        Indent<t_indent + 1>(), text("]\n"), //
+        Indent<t_indent>(), text("}")); //
+}
+
+} // namespace tet
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "tet/Transport.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tet {
+
+/**
+ * In-process transport for tests and benchmarks, no network and no broker.
+ *
+ * deliver() hands a message to the attached client in the calling thread, as
+ * if it had arrived from the controller. Everything the client publishes is
+ * passed to the sink in the publishing thread. Subscriptions match topics
+ * exactly, wildcards are not supported.
+ */
+class LoopbackTransport {
+public:
+    using Sink = Function::InplaceFunction<void(const Frame&, const Delivery&)>;
+
+    struct Stats {
+        std::uint32_t delivered;
+        std::uint32_t unsubscribed; // Messages passed to deliver() without a matching subscription.
+        std::uint32_t published;
+    };
+
+private:
+    Sink m_sink;
+    TransportEvents m_events;
+    bool m_attached = false;
+    bool m_connected = false;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::string> m_subscriptions;
+
+    Stats m_stats {};
+
+public:
+    explicit LoopbackTransport(Sink sink = nullptr)
+        : m_sink(sink) {
+    }
+
+    LoopbackTransport(const LoopbackTransport&) = delete;
+    LoopbackTransport& operator=(const LoopbackTransport&) = delete;
+
+    void attach(const TransportEvents& events) {
+        m_events = events;
+        m_attached = true;
+    }
+
+    void detach() {
+        m_attached = false;
+    }
+
+    void connect() {
+        m_connected = true;
+        if (m_attached)
+            m_events.connected();
+    }
+
+    void disconnect() {
+        m_connected = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_subscriptions.clear();
+        }
+        if (m_attached)
+            m_events.disconnected();
+    }
+
+    // Returns false if the client is not connected or not subscribed to the topic.
+    bool deliver(std::string_view topic, std::string_view payload) {
+        if (!m_connected || !m_attached)
+            return false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (std::find(m_subscriptions.begin(), m_subscriptions.end(), topic) == m_subscriptions.end()) {
+                ++m_stats.unsubscribed;
+                return false;
+            }
+            ++m_stats.delivered;
+        }
+        m_events.message(Frame { topic, payload });
+        return true;
+    }
+
+    bool subscribe(std::string_view topic, const Delivery&) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (std::find(m_subscriptions.begin(), m_subscriptions.end(), topic) == m_subscriptions.end())
+            m_subscriptions.emplace_back(topic);
+        return true;
+    }
+
+    bool publish(std::string_view topic, std::string_view payload, const Delivery& delivery) {
+        if (!m_connected)
+            return false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.published;
+        }
+        if (m_sink)
+            m_sink(Frame { topic, payload }, delivery);
+        return true;
+    }
+
+    bool connected() const {
+        return m_connected;
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+};
+
+static_assert(Transport<LoopbackTransport>);
+
+} // namespace tet
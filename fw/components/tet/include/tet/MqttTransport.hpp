@@ -0,0 +1,80 @@
+#pragma once
+
+#include "tet/Transport.hpp"
+
+#include "MQTT.hpp"
+
+#include <array>
+
+namespace tet {
+
+// Transport over an MQTT::Client, which stays owned and started by the application.
+class MqttTransport {
+private:
+    MQTT::Client& m_client;
+    TransportEvents m_events;
+    std::array<MQTT::Client::Handle, 3> m_handles {};
+    bool m_attached = false;
+
+    static MQTT::QOS qos(const Delivery& delivery) {
+        return static_cast<MQTT::QOS>(delivery.qos);
+    }
+
+public:
+    explicit MqttTransport(MQTT::Client& client)
+        : m_client(client) {
+    }
+
+    MqttTransport(const MqttTransport&) = delete;
+    MqttTransport& operator=(const MqttTransport&) = delete;
+
+    ~MqttTransport() {
+        detach();
+    }
+
+    void attach(const TransportEvents& events) {
+        using namespace MQTT::Event;
+
+        detach();
+        m_events = events;
+        m_handles = {
+            m_client.on(Id::Data, [this](Data event) {
+                m_events.message(Frame {
+                    std::string_view(event->topic, event->topic_len),
+                    std::string_view(event->data, event->data_len),
+                });
+            }),
+            m_client.on(Id::Connected, [this](Data) { m_events.connected(); }),
+            m_client.on(Id::Disconnected, [this](Data) { m_events.disconnected(); }),
+        };
+        m_attached = true;
+    }
+
+    void detach() {
+        using namespace MQTT::Event;
+
+        if (!m_attached)
+            return;
+        m_client.removeListener(Id::Data, m_handles[0]);
+        m_client.removeListener(Id::Connected, m_handles[1]);
+        m_client.removeListener(Id::Disconnected, m_handles[2]);
+        m_attached = false;
+    }
+
+    bool subscribe(std::string_view topic, const Delivery& delivery) {
+        m_client.subscribe(topic, qos(delivery));
+        return true;
+    }
+
+    bool publish(std::string_view topic, std::string_view payload, const Delivery& delivery) {
+        return m_client.publish(topic, payload, qos(delivery), delivery.retain, { .messageExpiry = delivery.expiry });
+    }
+
+    bool connected() const {
+        return m_client.connected();
+    }
+};
+
+static_assert(Transport<MqttTransport>);
+
+} // namespace tet
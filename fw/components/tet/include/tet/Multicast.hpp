@@ -0,0 +1,438 @@
+#pragma once
+
+#include "Function/InplaceFunction.hpp"
+
+#include "esp_log.h"
+#ifdef ESP_PLATFORM
+#include "esp_pthread.h"
+#endif
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace tet::Multicast {
+
+/**
+ * Show packets sent once to a multicast group and acted on by every station
+ * at the same time, without a broker in between.
+ *
+ * A packet is a 16 byte header followed by the body, all numbers little endian:
+ *
+ *     0  magic 'T'      1  version      2  type      3  session
+ *     4  sequence number, per sender and session
+ *     8  group mask, accepted by stations in any of the groups
+ *    12  station id, s_allStations for every station of the groups
+ *    14  frame: index of the first LED, cue: cue id
+ *    16  frame: r, g, b per LED, cue: data
+ */
+enum class Type : std::uint8_t {
+    Frame = 0,
+    Cue = 1,
+};
+
+static constexpr std::uint8_t s_magic = 'T';
+static constexpr std::uint8_t s_version = 1;
+static constexpr std::size_t s_headerSize = 16;
+static constexpr std::uint16_t s_allStations = 0xFFFF;
+
+struct Header {
+    Type type;
+    std::uint32_t sequence;
+    std::uint32_t groups;
+    std::uint16_t station;
+    std::uint16_t argument; // First LED of a frame or id of a cue.
+    // Picked at random when a sender starts, a new one tells receivers to start its sequence over.
+    std::uint8_t session = 0;
+};
+
+namespace detail {
+
+inline void put(std::string& out, std::uint32_t value, std::size_t bytes) {
+    for (std::size_t i = 0; i < bytes; ++i)
+        out += static_cast<char>(value >> (8 * i));
+}
+
+inline std::uint32_t get(std::string_view in, std::size_t offset, std::size_t bytes) {
+    std::uint32_t value = 0;
+    for (std::size_t i = 0; i < bytes; ++i)
+        value |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(in[offset + i])) << (8 * i);
+    return value;
+}
+
+} // namespace detail
+
+inline std::string encode(const Header& header, std::string_view body) {
+    std::string packet;
+    packet.reserve(s_headerSize + body.size());
+    packet += static_cast<char>(s_magic);
+    packet += static_cast<char>(s_version);
+    packet += static_cast<char>(header.type);
+    packet += static_cast<char>(header.session);
+    detail::put(packet, header.sequence, 4);
+    detail::put(packet, header.groups, 4);
+    detail::put(packet, header.station, 2);
+    detail::put(packet, header.argument, 2);
+    packet += body;
+    return packet;
+}
+
+// Header of a packet, empty if it is not a show packet of a known version.
+inline std::optional<Header> decode(std::string_view packet) {
+    if (packet.size() < s_headerSize
+        || static_cast<std::uint8_t>(packet[0]) != s_magic
+        || static_cast<std::uint8_t>(packet[1]) != s_version
+        || static_cast<std::uint8_t>(packet[2]) > static_cast<std::uint8_t>(Type::Cue))
+        return std::nullopt;
+    return Header {
+        .type = static_cast<Type>(packet[2]),
+        .sequence = detail::get(packet, 4, 4),
+        .groups = detail::get(packet, 8, 4),
+        .station = static_cast<std::uint16_t>(detail::get(packet, 12, 2)),
+        .argument = static_cast<std::uint16_t>(detail::get(packet, 14, 2)),
+        .session = static_cast<std::uint8_t>(packet[3]),
+    };
+}
+
+/**
+ * Classifies sequence numbers of one sender. Numbers wrap around, the last
+ * s_window numbers before the newest one are remembered to tell late packets
+ * from duplicates. A new session means the sender restarted, so does a
+ * number far behind the newest one, for senders that keep session 0.
+ */
+class Sequence {
+public:
+    enum class Order {
+        InOrder,
+        Ahead, // Packets in between are missing, for now.
+        Late, // Arrived after a newer one.
+        Duplicate,
+        Stale, // Too old to tell, treated as late.
+    };
+
+    struct Stats {
+        std::uint32_t lost; // Missing packets that have not arrived late.
+        std::uint32_t reordered;
+        std::uint32_t duplicates;
+        std::uint32_t restarts;
+    };
+
+    static constexpr std::uint32_t s_window = 64;
+    static constexpr std::uint32_t s_restartDistance = 1024;
+
+private:
+    bool m_started = false;
+    std::uint8_t m_session = 0;
+    std::uint32_t m_newest = 0;
+    std::uint64_t m_seen = 0; // Bit i set if m_newest - 1 - i arrived.
+    Stats m_stats {};
+
+public:
+    Order feed(std::uint32_t sequence, std::uint8_t session = 0) {
+        if (m_started && session != m_session) {
+            ++m_stats.restarts;
+            m_started = false;
+        }
+        if (!m_started) {
+            m_started = true;
+            m_session = session;
+            m_newest = sequence;
+            m_seen = 0;
+            return Order::InOrder;
+        }
+
+        auto distance = static_cast<std::int32_t>(sequence - m_newest);
+        if (distance > 0) {
+            m_stats.lost += distance - 1;
+            m_seen = distance >= 64 ? 0 : m_seen << distance;
+            if (distance <= 64)
+                m_seen |= std::uint64_t(1) << (distance - 1);
+            m_newest = sequence;
+            return distance == 1 ? Order::InOrder : Order::Ahead;
+        }
+        if (distance == 0) {
+            ++m_stats.duplicates;
+            return Order::Duplicate;
+        }
+
+        auto behind = static_cast<std::uint32_t>(-distance);
+        if (behind > s_restartDistance) {
+            ++m_stats.restarts;
+            m_newest = sequence;
+            m_seen = 0;
+            return Order::InOrder;
+        }
+        if (behind > s_window) {
+            ++m_stats.reordered;
+            return Order::Stale;
+        }
+
+        std::uint64_t bit = std::uint64_t(1) << (behind - 1);
+        if (m_seen & bit) {
+            ++m_stats.duplicates;
+            return Order::Duplicate;
+        }
+        m_seen |= bit;
+        ++m_stats.reordered;
+        if (m_stats.lost)
+            --m_stats.lost;
+        return Order::Late;
+    }
+
+    void reset() {
+        m_started = false;
+    }
+
+    Stats stats() const { return m_stats; }
+};
+
+inline Sequence::Stats& operator+=(Sequence::Stats& total, const Sequence::Stats& stats) {
+    total.lost += stats.lost;
+    total.reordered += stats.reordered;
+    total.duplicates += stats.duplicates;
+    total.restarts += stats.restarts;
+    return total;
+}
+
+/**
+ * Receives show packets from a multicast group on its own thread.
+ *
+ * Frames addressed to this station are written straight into the LED buffer,
+ * then onFrame is called with the range that changed. Frames that arrive
+ * after a newer one are dropped, late cues are still delivered. Duplicates
+ * of either are dropped. Sequences are tracked per sender address and port,
+ * for the s_maxSenders senders heard most recently. Writes to the buffer
+ * happen on the listener thread,
+ * both callbacks run there too, so they must synchronize with whatever else
+ * drives the LEDs, e.g. by holding tet::Client::lock().
+ *
+ * Pixel has to be constructible from r, g and b, e.g. SmartLeds' Rgb.
+ */
+template <typename Pixel>
+class Listener {
+public:
+    using FrameCallback = Function::InplaceFunction<void(std::size_t first, std::size_t count)>;
+    using CueCallback = Function::InplaceFunction<void(std::uint16_t cue, std::string_view data)>;
+
+    struct Config {
+        std::string group = "239.0.84.1";
+        std::uint16_t port = 47810;
+        // Address of the interface to join on, any picks the one the group is routed to.
+        std::string interface = "0.0.0.0";
+        std::uint32_t groups = 1; // Groups this station is part of, one bit each.
+        std::uint16_t station = 0;
+        std::size_t maxPacket = 1472;
+        std::size_t stackSize = 6 * 1024;
+    };
+
+    struct Stats {
+        std::uint32_t received;
+        std::uint32_t frames;
+        std::uint32_t cues;
+        std::uint32_t ignored; // Addressed to other stations or groups.
+        std::uint32_t malformed;
+        std::uint32_t lost;
+        std::uint32_t reordered;
+        std::uint32_t duplicates;
+    };
+
+    static constexpr std::size_t s_maxSenders = 4;
+
+private:
+    static constexpr const char* s_tag = "tet::Multicast";
+    static constexpr int s_pollMs = 200;
+
+    struct Sender {
+        in_addr_t address;
+        in_port_t port;
+        Sequence sequence;
+        std::uint32_t lastHeard; // Value of m_stats.received when its last packet arrived.
+    };
+
+    const Config m_config;
+    const std::span<Pixel> m_leds;
+    FrameCallback m_onFrame;
+    CueCallback m_onCue;
+
+    int m_socket = -1;
+    std::atomic_bool m_running = false;
+    std::thread m_receiver;
+
+    mutable std::mutex m_mutex;
+    std::vector<Sender> m_senders;
+    Sequence::Stats m_forgotten {}; // Of senders that made room for others.
+    Stats m_stats {};
+
+    bool addressed(const Header& header) const {
+        return (header.groups & m_config.groups)
+            && (header.station == s_allStations || header.station == m_config.station);
+    }
+
+    // m_mutex is held. A sender not heard of replaces the one heard least recently, once there are s_maxSenders.
+    Sequence& sequenceOf(const sockaddr_in& source) {
+        auto sender = std::find_if(m_senders.begin(), m_senders.end(), [&](const Sender& sender) {
+            return sender.address == source.sin_addr.s_addr && sender.port == source.sin_port;
+        });
+        if (sender == m_senders.end()) {
+            if (m_senders.size() < s_maxSenders) {
+                sender = m_senders.emplace(m_senders.end());
+            } else {
+                sender = std::min_element(m_senders.begin(), m_senders.end(), [](const Sender& a, const Sender& b) {
+                    return a.lastHeard < b.lastHeard;
+                });
+                m_forgotten += sender->sequence.stats();
+            }
+            *sender = Sender { source.sin_addr.s_addr, source.sin_port, Sequence(), 0 };
+        }
+        sender->lastHeard = m_stats.received;
+        return sender->sequence;
+    }
+
+    void receive() {
+        std::vector<char> buffer(m_config.maxPacket);
+        while (m_running) {
+            sockaddr_in source = {};
+            socklen_t sourceLength = sizeof(source);
+            ssize_t length = recvfrom(m_socket, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&source), &sourceLength);
+            if (length > 0)
+                handle(std::string_view(buffer.data(), length), source);
+        }
+    }
+
+    void writeFrame(std::size_t first, std::string_view body) {
+        std::size_t count = std::min(body.size() / 3, first < m_leds.size() ? m_leds.size() - first : 0);
+        for (std::size_t i = 0; i < count; ++i) {
+            auto rgb = reinterpret_cast<const std::uint8_t*>(body.data() + 3 * i);
+            m_leds[first + i] = Pixel(rgb[0], rgb[1], rgb[2]);
+        }
+        if (m_onFrame)
+            m_onFrame(first, count);
+    }
+
+public:
+    Listener(const Config& config, std::span<Pixel> leds, FrameCallback onFrame = nullptr, CueCallback onCue = nullptr)
+        : m_config(config)
+        , m_leds(leds)
+        , m_onFrame(onFrame)
+        , m_onCue(onCue) {
+    }
+
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+
+    ~Listener() {
+        stop();
+    }
+
+    void start() {
+        if (m_running)
+            return;
+
+        m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (m_socket < 0)
+            throw std::runtime_error("Failed to create multicast socket");
+
+        int reuse = 1;
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(m_config.port);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        ip_mreq membership = {};
+        timeval timeout = { .tv_sec = 0, .tv_usec = s_pollMs * 1000 };
+        if (inet_aton(m_config.group.c_str(), &membership.imr_multiaddr) == 0
+            || inet_aton(m_config.interface.c_str(), &membership.imr_interface) == 0
+            || setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+            || bind(m_socket, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0
+            || setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0
+            || setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0) {
+            close(m_socket);
+            m_socket = -1;
+            throw std::runtime_error("Failed to join multicast group " + m_config.group);
+        }
+
+#ifdef ESP_PLATFORM
+        esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+        cfg.stack_size = m_config.stackSize;
+        cfg.thread_name = "tet_multicast";
+        esp_pthread_set_cfg(&cfg);
+#endif
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& sender : m_senders)
+                m_forgotten += sender.sequence.stats();
+            m_senders.clear();
+        }
+        m_running = true;
+        m_receiver = std::thread([this] { receive(); });
+        ESP_LOGI(s_tag, "Joined %s:%u", m_config.group.c_str(), static_cast<unsigned>(m_config.port));
+    }
+
+    void stop() {
+        if (!m_running)
+            return;
+        m_running = false;
+        m_receiver.join();
+        close(m_socket);
+        m_socket = -1;
+    }
+
+    // Processes one packet as if it had been received from source, the receiving thread calls this.
+    void handle(std::string_view packet, const sockaddr_in& source) {
+        std::optional<Header> header = decode(packet);
+        Sequence::Order order;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.received;
+            if (!header) {
+                ++m_stats.malformed;
+                return;
+            }
+            // Every station sees every packet, so the sequence is checked before addressing.
+            order = sequenceOf(source).feed(header->sequence, header->session);
+            if (order == Sequence::Order::Duplicate)
+                return;
+            if (!addressed(*header)) {
+                ++m_stats.ignored;
+                return;
+            }
+            if (header->type == Type::Frame && (order == Sequence::Order::Late || order == Sequence::Order::Stale))
+                return;
+            ++(header->type == Type::Frame ? m_stats.frames : m_stats.cues);
+        }
+
+        std::string_view body = packet.substr(s_headerSize);
+        if (header->type == Type::Frame)
+            writeFrame(header->argument, body);
+        else if (m_onCue)
+            m_onCue(header->argument, body);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Sequence::Stats sequence = m_forgotten;
+        for (const auto& sender : m_senders)
+            sequence += sender.sequence.stats();
+        Stats stats = m_stats;
+        stats.lost = sequence.lost;
+        stats.reordered = sequence.reordered;
+        stats.duplicates = sequence.duplicates;
+        return stats;
+    }
+};
+
+} // namespace tet::Multicast
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+namespace tet {
+
+// Same values as MQTT QoS levels, transports without acknowledgements treat all of them as AtMostOnce.
+enum class QOS : std::uint8_t {
+    AtMostOnce = 0,
+    AtLeastOnce = 1,
+    ExactlyOnce = 2,
+};
+
+struct Delivery {
+    QOS qos;
+    bool retain = false;
+    std::uint32_t expiry = 0; // MQTT 5 message expiry in seconds, 0 means none.
+};
+
+/**
+ * QoS and retain flag for each class of message a tet::Client exchanges.
+ *
+ * QoS 2 costs four packets per message, so it is only worth it where a
+ * duplicate or a loss actually hurts. Frames are superseded by the next
+ * one, so they go out at QoS 0 and expire after a second.
+ */
+struct Policy {
+    // Subscription QoS, retain is ignored. QoS 1 is enough when every command carries an "id".
+    Delivery commands { QOS::ExactlyOnce };
+    Delivery events { QOS::AtLeastOnce };
+    Delivery state { QOS::AtLeastOnce, true }; // Deltas use the same QoS but are never retained.
+    Delivery frames { QOS::AtMostOnce, false, 1 };
+    Delivery schema { QOS::AtLeastOnce, true };
+    Delivery errors { QOS::AtLeastOnce };
+};
+
+} // namespace tet
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace tet {
+
+/**
+ * Key of a command's "id" member, which may be an unsigned number or a string.
+ * Strings are hashed with FNV-1a, numbers are used as they are.
+ */
+inline std::optional<std::uint64_t> idempotencyKey(const nlohmann::json& command) {
+    auto id = command.find("id");
+    if (id == command.end())
+        return std::nullopt;
+    if (id->is_number_unsigned())
+        return id->get<std::uint64_t>();
+    if (!id->is_string())
+        return std::nullopt;
+
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (char c : id->get_ref<const std::string&>()) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+/**
+ * Fixed-size set of the most recently executed command ids.
+ *
+ * The ids live in a ring, so the oldest one is forgotten once t_capacity newer
+ * ones were inserted. A redelivery has to arrive within that window to be
+ * recognized.
+ */
+template <std::size_t t_capacity>
+class RecentIds {
+private:
+    std::array<std::uint64_t, t_capacity> m_ids {};
+    std::size_t m_next = 0;
+    std::size_t m_size = 0;
+
+public:
+    bool contains(std::uint64_t id) const noexcept {
+        return std::find(m_ids.begin(), m_ids.begin() + m_size, id) != m_ids.begin() + m_size;
+    }
+
+    void insert(std::uint64_t id) noexcept {
+        m_ids[m_next] = id;
+        m_next = (m_next + 1) % t_capacity;
+        m_size = std::min(m_size + 1, t_capacity);
+    }
+
+    void clear() noexcept {
+        m_next = 0;
+        m_size = 0;
+    }
+};
+
+} // namespace tet
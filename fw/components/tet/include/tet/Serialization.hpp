@@ -0,0 +1,154 @@
+#pragma once
+
+#include "tet/Command.hpp"
+#include "tet/State.hpp"
+
+#include "esp_log.h"
+
+#include <glaze/glaze.hpp>
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace tet {
+
+enum class Format {
+    Json,
+    Beve,
+};
+
+template <typename T>
+concept Serializable = requires(const T& value, std::string& buffer) {
+    { glz::write_json(value, buffer) };
+};
+
+template <Format t_format, typename T>
+bool serialize(const T& value, std::string& out) noexcept {
+    if constexpr (t_format == Format::Json)
+        return !glz::write_json(value, out);
+    else
+        return !glz::write_beve(value, out);
+}
+
+template <typename T>
+bool serialize(Format format, const T& value, std::string& out) noexcept {
+    switch (format) {
+    case Format::Beve:
+        return serialize<Format::Beve>(value, out);
+    default:
+        return serialize<Format::Json>(value, out);
+    }
+}
+
+namespace detail {
+
+template <typename T>
+struct is_std_array : std::false_type {};
+
+template <typename T, std::size_t N>
+struct is_std_array<std::array<T, N>> : std::true_type {};
+
+template <typename T>
+struct is_std_vector : std::false_type {};
+
+template <typename T, typename Allocator>
+struct is_std_vector<std::vector<T, Allocator>> : std::true_type {};
+
+} // namespace detail
+
+/**
+ * Fills a reflectable aggregate from already validated command data.
+ *
+ * Commands are parsed and validated as nlohmann::json, glaze only supplies
+ * the member names through its compile-time reflection, so the argument
+ * struct only has to mirror the command's tet::Argument tree. The values are
+ * read from the nlohmann tree. Missing optional members keep their default
+ * value.
+ *
+ * Only non-throwing accessors are used. Returns false if a value has another
+ * type than its member, the members read until then are filled.
+ */
+template <typename T>
+bool fromJson(const nlohmann::json& json, T& out) noexcept {
+    if constexpr (detail::is_std_array<T>::value) {
+        if (!json.is_array())
+            return false;
+        const auto& items = json.template get_ref<const nlohmann::json::array_t&>();
+        for (std::size_t i = 0; i < out.size() && i < items.size(); ++i) {
+            if (!fromJson(items[i], out[i]))
+                return false;
+        }
+        return true;
+    } else if constexpr (detail::is_std_vector<T>::value) {
+        if (!json.is_array())
+            return false;
+        const auto& items = json.template get_ref<const nlohmann::json::array_t&>();
+        out.resize(items.size());
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            if (!fromJson(items[i], out[i]))
+                return false;
+        }
+        return true;
+    } else if constexpr (glz::reflectable<T>) {
+        if (!json.is_object())
+            return false;
+        constexpr auto keys = glz::reflect<T>::keys;
+        auto fields = glz::to_tie(out);
+        return [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+            return ([&] {
+                auto it = json.find(keys[Is]);
+                return it == json.end() || fromJson(*it, glz::get<Is>(fields));
+            }() && ...);
+        }(std::make_index_sequence<glz::reflect<T>::size>());
+    } else if constexpr (std::same_as<T, bool>) {
+        const bool* value = json.template get_ptr<const bool*>();
+        if (value)
+            out = *value;
+        return value != nullptr;
+    } else if constexpr (std::is_arithmetic_v<T>) {
+        if (const auto* value = json.template get_ptr<const nlohmann::json::number_integer_t*>())
+            out = static_cast<T>(*value);
+        else if (const auto* value = json.template get_ptr<const nlohmann::json::number_unsigned_t*>())
+            out = static_cast<T>(*value);
+        else if (const auto* value = json.template get_ptr<const nlohmann::json::number_float_t*>())
+            out = static_cast<T>(*value);
+        else
+            return false;
+        return true;
+    } else if constexpr (std::same_as<T, std::string>) {
+        const std::string* value = json.template get_ptr<const std::string*>();
+        if (value)
+            out = *value;
+        return value != nullptr;
+    } else {
+        static_assert(glz::reflectable<T>, "Unsupported argument type");
+    }
+}
+
+/**
+ * Adapts a callback taking a typed argument struct to tet::Callback.
+ *
+ *     constexpr tet::Command fillTop("fillTop", "Fill Top", std::make_tuple(color),
+ *         tet::typed<State, ColorArgs, &fillTopImpl>());
+ *
+ * Data that does not fit the struct leaves the state unchanged.
+ */
+template <HW::State State, typename Args, State (*t_function)(const State&, const Args&)>
+constexpr Callback<State> typed() {
+    return Callback<State>(+[](const State& state, const nlohmann::json& data) {
+        Args args {};
+        if (!fromJson(data, args)) {
+            ESP_LOGW("tet::typed", "Command data does not match its arguments");
+            return state;
+        }
+        return t_function(state, args);
+    });
+}
+
+} // namespace tet
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "tet/Policy.hpp"
+
+#include "Function/InplaceFunction.hpp"
+
+#include <concepts>
+#include <string_view>
+
+namespace tet {
+
+// A received message, only valid during the callback it is passed to.
+struct Frame {
+    std::string_view topic;
+    std::string_view payload;
+};
+
+// Called by a transport from whichever task it receives on.
+struct TransportEvents {
+    Function::InplaceFunction<void(const Frame&)> message;
+    Function::InplaceFunction<void()> connected;
+    Function::InplaceFunction<void()> disconnected;
+};
+
+/**
+ * What a tet::Client needs from the link to the controller.
+ *
+ * A transport reports to at most one attached set of events. It may report
+ * messages on topics that were not subscribed, the client filters them.
+ * Subscriptions are made again on every connect. Publishing returns false if
+ * the message was not accepted, delivery beyond that depends on the transport.
+ *
+ * Backends: MqttTransport, LoopbackTransport and UdpTransport.
+ */
+template <typename T>
+concept Transport = requires(T& transport, const T& constTransport, const TransportEvents& events, std::string_view topic, std::string_view payload, const Delivery& delivery) {
+    { transport.attach(events) } -> std::same_as<void>;
+    { transport.detach() } -> std::same_as<void>;
+    { transport.subscribe(topic, delivery) } -> std::same_as<bool>;
+    { transport.publish(topic, payload, delivery) } -> std::same_as<bool>;
+    { constTransport.connected() } -> std::same_as<bool>;
+};
+
+} // namespace tet
@@ -0,0 +1,258 @@
+#pragma once
+
+#include "tet/Transport.hpp"
+
+#include "esp_log.h"
+#ifdef ESP_PLATFORM
+#include "esp_pthread.h"
+#endif
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace tet {
+
+/**
+ * Transport over plain UDP datagrams, for a controller on the same LAN.
+ *
+ * Without a broker in between a command takes a single hop. Each datagram
+ * carries one message: the topic length as one byte, the topic and the
+ * payload. There are no acknowledgements, so every QoS is AtMostOnce and
+ * retain and expiry are ignored; commands that must not get lost should carry
+ * an "id" and be repeated by the controller. Messages larger than
+ * Config::maxDatagram are neither sent nor accepted.
+ *
+ * Only datagrams from the peer's address are accepted, from any of its ports.
+ * This is no authentication, a sender on the LAN can still spoof the address.
+ * The transport counts as connected between start() and stop(),
+ * subscriptions match topics exactly.
+ */
+class UdpTransport {
+public:
+    struct Config {
+        std::string peer; // Host the messages are sent to.
+        std::uint16_t peerPort = 47800;
+        std::uint16_t localPort = 47800;
+        // Fits an Ethernet frame without IP fragmentation.
+        std::size_t maxDatagram = 1472;
+        // Commands are handled in the receiving thread.
+        std::size_t stackSize = 8 * 1024;
+    };
+
+    struct Stats {
+        std::uint32_t received;
+        std::uint32_t sent;
+        std::uint32_t malformed; // Topic empty or past the end, or larger than Config::maxDatagram.
+        std::uint32_t foreign; // Sent by another host than the peer.
+        std::uint32_t unsubscribed; // Received on a topic without a subscription.
+        std::uint32_t dropped; // Not sent, because of size or a socket error.
+    };
+
+private:
+    static constexpr const char* s_tag = "tet::UdpTransport";
+    static constexpr int s_pollMs = 200;
+
+    const Config m_config;
+    int m_socket = -1;
+    sockaddr_storage m_peer {};
+    socklen_t m_peerLength = 0;
+
+    TransportEvents m_events;
+    std::atomic_bool m_attached = false;
+    std::atomic_bool m_running = false;
+    std::thread m_receiver;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::string> m_subscriptions;
+
+    std::atomic<std::uint32_t> m_received = 0;
+    std::atomic<std::uint32_t> m_sent = 0;
+    std::atomic<std::uint32_t> m_malformed = 0;
+    std::atomic<std::uint32_t> m_foreign = 0;
+    std::atomic<std::uint32_t> m_unsubscribed = 0;
+    std::atomic<std::uint32_t> m_dropped = 0;
+
+    bool subscribed(std::string_view topic) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return std::find(m_subscriptions.begin(), m_subscriptions.end(), topic) != m_subscriptions.end();
+    }
+
+    bool fromPeer(const sockaddr_storage& source) const {
+        if (source.ss_family != AF_INET)
+            return false;
+        return reinterpret_cast<const sockaddr_in&>(source).sin_addr.s_addr
+            == reinterpret_cast<const sockaddr_in&>(m_peer).sin_addr.s_addr;
+    }
+
+    void receive() {
+        // One byte more than accepted, a longer datagram would otherwise be cut silently.
+        std::vector<char> buffer(m_config.maxDatagram + 1);
+        while (m_running) {
+            sockaddr_storage source {};
+            socklen_t sourceLength = sizeof(source);
+            ssize_t length = recvfrom(m_socket, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&source), &sourceLength);
+            if (length <= 0)
+                continue; // Timed out, checks whether to stop.
+            if (!fromPeer(source)) {
+                ++m_foreign;
+                continue;
+            }
+
+            std::size_t topicLength = static_cast<std::uint8_t>(buffer[0]);
+            if (static_cast<std::size_t>(length) > m_config.maxDatagram || topicLength == 0 || 1 + topicLength > static_cast<std::size_t>(length)) {
+                ++m_malformed;
+                continue;
+            }
+
+            std::string_view topic(buffer.data() + 1, topicLength);
+            std::string_view payload(buffer.data() + 1 + topicLength, length - 1 - topicLength);
+            if (!subscribed(topic)) {
+                ++m_unsubscribed;
+                continue;
+            }
+            ++m_received;
+            if (m_attached)
+                m_events.message(Frame { topic, payload });
+        }
+    }
+
+public:
+    explicit UdpTransport(const Config& config)
+        : m_config(config) {
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* address = nullptr;
+        std::string port = std::to_string(config.peerPort);
+        if (getaddrinfo(config.peer.c_str(), port.c_str(), &hints, &address) != 0 || !address)
+            throw std::runtime_error("Failed to resolve UDP peer " + config.peer);
+        std::memcpy(&m_peer, address->ai_addr, address->ai_addrlen);
+        m_peerLength = address->ai_addrlen;
+        freeaddrinfo(address);
+    }
+
+    UdpTransport(const UdpTransport&) = delete;
+    UdpTransport& operator=(const UdpTransport&) = delete;
+
+    ~UdpTransport() {
+        stop();
+    }
+
+    void start() {
+        if (m_running)
+            return;
+
+        m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (m_socket < 0)
+            throw std::runtime_error("Failed to create UDP socket");
+
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(m_config.localPort);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        timeval timeout = { .tv_sec = 0, .tv_usec = s_pollMs * 1000 };
+        if (bind(m_socket, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0
+            || setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0) {
+            close(m_socket);
+            m_socket = -1;
+            throw std::runtime_error("Failed to bind UDP port " + std::to_string(m_config.localPort));
+        }
+
+#ifdef ESP_PLATFORM
+        esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+        cfg.stack_size = m_config.stackSize;
+        cfg.thread_name = "tet_udp";
+        esp_pthread_set_cfg(&cfg);
+#endif
+        m_running = true;
+        m_receiver = std::thread([this] { receive(); });
+        ESP_LOGI(s_tag, "Listening on UDP port %u", static_cast<unsigned>(m_config.localPort));
+        if (m_attached)
+            m_events.connected();
+    }
+
+    void stop() {
+        if (!m_running)
+            return;
+        m_running = false;
+        m_receiver.join();
+        close(m_socket);
+        m_socket = -1;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_subscriptions.clear();
+        }
+        if (m_attached)
+            m_events.disconnected();
+    }
+
+    void attach(const TransportEvents& events) {
+        m_attached = false;
+        m_events = events;
+        m_attached = true;
+    }
+
+    void detach() {
+        m_attached = false;
+    }
+
+    bool subscribe(std::string_view topic, const Delivery&) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (std::find(m_subscriptions.begin(), m_subscriptions.end(), topic) == m_subscriptions.end())
+            m_subscriptions.emplace_back(topic);
+        return true;
+    }
+
+    bool publish(std::string_view topic, std::string_view payload, const Delivery&) {
+        std::size_t size = 1 + topic.size() + payload.size();
+        if (!m_running || topic.empty() || topic.size() > 0xFF || size > m_config.maxDatagram) {
+            ++m_dropped;
+            return false;
+        }
+
+        std::string datagram;
+        datagram.reserve(size);
+        datagram += static_cast<char>(topic.size());
+        datagram += topic;
+        datagram += payload;
+        if (sendto(m_socket, datagram.data(), datagram.size(), 0, reinterpret_cast<const sockaddr*>(&m_peer), m_peerLength) != static_cast<ssize_t>(size)) {
+            ++m_dropped;
+            return false;
+        }
+        ++m_sent;
+        return true;
+    }
+
+    bool connected() const {
+        return m_running;
+    }
+
+    Stats stats() const {
+        return {
+            .received = m_received.load(),
+            .sent = m_sent.load(),
+            .malformed = m_malformed.load(),
+            .foreign = m_foreign.load(),
+            .unsubscribed = m_unsubscribed.load(),
+            .dropped = m_dropped.load(),
+        };
+    }
+};
+
+static_assert(Transport<UdpTransport>);
+
+} // namespace tet
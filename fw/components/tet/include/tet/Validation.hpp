@@ -0,0 +1,112 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace tet {
+
+enum class Error : std::uint8_t {
+    None = 0,
+    InvalidJson,
+    MissingCommand,
+    UnknownCommand,
+    MissingField,
+    InvalidType,
+    OutOfRange,
+    InvalidLength,
+};
+
+/**
+ * Path to the offending value, e.g. "colors[3].r".
+ *
+ * Validators fail at the innermost value and the path is built while unwinding,
+ * so segments are prepended into a fixed buffer. If the path does not fit,
+ * the outermost segments are dropped and the path starts with "~".
+ */
+class ErrorPath {
+public:
+    static constexpr std::size_t s_capacity = 64;
+
+private:
+    std::array<char, s_capacity> m_buffer {};
+    std::size_t m_begin = s_capacity;
+    bool m_truncated = false;
+
+    void prepend(char c) noexcept {
+        if (m_begin == 0) {
+            m_truncated = true;
+            m_buffer[0] = '~';
+            return;
+        }
+        m_buffer[--m_begin] = c;
+    }
+
+    void prepend(std::string_view text) noexcept {
+        for (auto it = text.rbegin(); it != text.rend(); ++it)
+            prepend(*it);
+    }
+
+public:
+    void push(std::string_view name) noexcept {
+        if (m_begin != s_capacity && m_buffer[m_begin] != '[')
+            prepend('.');
+        prepend(name);
+    }
+
+    void push(std::size_t index) noexcept {
+        if (m_begin != s_capacity && m_buffer[m_begin] != '[')
+            prepend('.');
+        prepend(']');
+        do {
+            prepend(static_cast<char>('0' + index % 10));
+            index /= 10;
+        } while (index != 0);
+        prepend('[');
+    }
+
+    void clear() noexcept {
+        m_begin = s_capacity;
+        m_truncated = false;
+    }
+
+    bool truncated() const noexcept { return m_truncated; }
+
+    std::string_view view() const noexcept {
+        return { m_buffer.data() + m_begin, s_capacity - m_begin };
+    }
+};
+
+/**
+ * Validates `object[name]`, prepending `name` to the path on failure.
+ */
+template <typename Property>
+Error validateMember(const Property& argument, const nlohmann::json& object, ErrorPath& path) noexcept {
+    auto it = object.find(argument.name.view());
+    if (it == object.end()) {
+        if (!argument.required)
+            return Error::None;
+        path.push(argument.name.view());
+        return Error::MissingField;
+    }
+
+    Error error = argument.validate(*it, path);
+    if (error != Error::None)
+        path.push(argument.name.view());
+    return error;
+}
+
+template <typename... Properties>
+Error validateMembers(const std::tuple<Properties...>& properties, const nlohmann::json& object, ErrorPath& path) noexcept {
+    Error error = Error::None;
+    std::apply([&](const auto&... property) {
+        (((error = validateMember(property, object, path)) == Error::None) && ...);
+    },
+        properties);
+    return error;
+}
+
+} // namespace tet
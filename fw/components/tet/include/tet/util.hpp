@@ -3,49 +3,296 @@
 #include "coll/basic_fixed_string.h"
 #include "coll/basic_string.h"
 
-#include <tuple>
+#include <algorithm>
+#include <concepts>
 #include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace tet {
 
 template <std::size_t N>
 using fixed_string = coll::basic_fixed_string<char, N>;
 
-template <std::size_t M, std::size_t N>
-consteval fixed_string<N * M> multiply(const fixed_string<N>& str) {
-    if constexpr (M == 0)
-        return "";
-    else
-        return str + multiply<M - 1>(str);
-}
+/**
+ * Schemas are built from pieces whose length is part of their type. The total
+ * length of a schema is therefore known before anything is encoded and the
+ * whole schema is written into a single buffer in one pass, instead of
+ * concatenating ever growing fixed_strings.
+ *
+ * Encodable types provide `pieces<t_indent>()` returning a tuple of
+ * fixed_strings, Indents, Decimals, Conditionals, Nested values and
+ * NestedLists. Decimals and Conditionals reserve their longest form, so the
+ * buffer is an upper bound and the encoded schema may be shorter.
+ */
+template <std::size_t t_indent>
+struct Indent {};
+
+template <std::size_t t_indent, typename T>
+struct Nested {
+    const T& value;
+};
+
+// Items encoded one per line at t_indent + 1, separated by commas.
+template <std::size_t t_indent, typename Tuple>
+struct NestedList {
+    Tuple values;
+};
 
 template <std::size_t N>
-constexpr fixed_string<N * 2> indent = indent<N - 1> + "  ";
+consteval fixed_string<N - 1> text(const char (&value)[N]) {
+    return fixed_string<N - 1>(value);
+}
+
+template <std::size_t t_indent, typename T>
+consteval Nested<t_indent, T> nested(const T& value) {
+    return { value };
+}
+
+template <std::size_t t_indent, typename... Items>
+consteval NestedList<t_indent, std::tuple<const Items&...>> nestedList(const std::tuple<Items...>& items) {
+    return { std::apply([](const auto&... item) { return std::tuple<const Items&...>(item...); }, items) };
+}
 
-template <>
-constexpr fixed_string<0> indent<0>("");
+// A quoted string on its own line, used for lists mapping ids to names.
+template <std::size_t N>
+struct Quoted {
+    const fixed_string<N>& value;
 
-template<std::size_t t_indent, std::size_t t_idx, typename ...Properties>
-consteval auto encodeMultiple(const std::tuple<Properties...>& properties) noexcept {
-    constexpr std::size_t size = std::tuple_size_v<std::decay_t<decltype(properties)>>;
-    if constexpr (size == 0)
-        return fixed_string<0>("");
-    else if constexpr(t_idx == size - 1)
-        return std::get<t_idx>(properties).template encode<t_indent + 1>() + "\n";
-    else {
-        return std::get<t_idx>(properties).template encode<t_indent + 1>() + ",\n" + encodeMultiple<t_indent, t_idx + 1>(properties);
+    template <std::size_t t_indent = 0>
+    consteval auto pieces() const noexcept {
+        return std::make_tuple(Indent<t_indent>(), text("\""), value, text("\""));
     }
+};
+
+template <std::size_t N>
+Quoted(const fixed_string<N>&) -> Quoted<N>;
+
+// Names of the items in their tuple order, the position in the list is the item's id.
+template <std::size_t t_indent, typename... Items, typename Projection>
+consteval auto nameList(const std::tuple<Items...>& items, Projection name) {
+    auto names = std::apply([&](const auto&... item) { return std::make_tuple(Quoted { name(item) }...); }, items);
+    return NestedList<t_indent, decltype(names)> { names };
 }
 
+// A number written as short as possible, taking at most t_width characters.
+template <std::size_t t_width, typename T>
+struct Decimal {
+    T value;
+};
+
+template <std::size_t t_width, typename T>
+consteval Decimal<t_width, T> decimal(T value) {
+    return { value };
+}
+
+// Pieces written only if present, e.g. limits that were set. They always count towards the capacity.
+template <typename Tuple>
+struct Conditional {
+    Tuple pieces;
+    bool present;
+};
+
+template <typename... Pieces>
+consteval Conditional<std::tuple<Pieces...>> when(bool present, Pieces... pieces) {
+    return { std::make_tuple(pieces...), present };
+}
+
+template <typename Piece>
+struct PieceSize;
+
 template <std::size_t N>
-consteval fixed_string<N> to_string(int value) {
-    if (value < 0)
-        return "-" + to_string<N - 1>(-value);
-    
-    if (value < 10)
-        return fixed_string<1>(1, '0' + value);
+struct PieceSize<fixed_string<N>> : std::integral_constant<std::size_t, N> {};
+
+template <std::size_t t_indent>
+struct PieceSize<Indent<t_indent>> : std::integral_constant<std::size_t, 2 * t_indent> {};
+
+template <std::size_t t_width, typename T>
+struct PieceSize<Decimal<t_width, T>> : std::integral_constant<std::size_t, t_width> {};
+
+template <typename Tuple>
+struct PieceSize<Conditional<Tuple>> : PieceSize<Tuple> {};
+
+template <typename... Pieces>
+struct PieceSize<std::tuple<Pieces...>> : std::integral_constant<std::size_t, (PieceSize<Pieces>::value + ... + 0)> {};
+
+template <std::size_t t_indent, typename T>
+struct PieceSize<Nested<t_indent, T>> : PieceSize<decltype(std::declval<const T&>().template pieces<t_indent>())> {};
+
+template <std::size_t t_indent, typename... Items>
+struct PieceSize<NestedList<t_indent, std::tuple<Items...>>>
+    : std::integral_constant<std::size_t,
+          (PieceSize<Nested<t_indent + 1, std::remove_cvref_t<Items>>>::value + ... + 0)
+              + (sizeof...(Items) == 0 ? 0 : 2 * sizeof...(Items) - 1)> {};
+
+// Digits of value, most significant first, returns their count.
+consteval std::size_t formatDigits(char* out, std::uintmax_t value, std::size_t minDigits = 1) {
+    char reversed[std::numeric_limits<std::uintmax_t>::digits10 + 1] {};
+    std::size_t count = 0;
+    do {
+        reversed[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0 || count < minDigits);
+    for (std::size_t i = 0; i < count; ++i)
+        out[i] = reversed[count - 1 - i];
+    return count;
+}
+
+template <std::integral T>
+consteval std::size_t formatDecimal(char* out, T value) {
+    std::size_t size = 0;
+    auto magnitude = static_cast<std::uintmax_t>(value);
+    if (value < 0) {
+        out[size++] = '-';
+        magnitude = ~magnitude + 1;
+    }
+    return size + formatDigits(out + size, magnitude);
+}
+
+// Fixed point with up to t_precision decimals, trailing zeros and an empty fraction are dropped.
+template <std::floating_point T, std::size_t t_precision = 6>
+consteval std::size_t formatDecimal(char* out, T value) {
+    if (value != value || value > std::numeric_limits<std::int64_t>::max() || value < std::numeric_limits<std::int64_t>::min())
+        throw std::domain_error("Number cannot be represented in fixed point notation");
+
+    std::uintmax_t scale = 1;
+    for (std::size_t i = 0; i < t_precision; ++i)
+        scale *= 10;
+
+    std::size_t size = 0;
+    if (value < 0) {
+        out[size++] = '-';
+        value = -value;
+    }
+
+    auto integral = static_cast<std::uintmax_t>(value);
+    auto fraction = static_cast<std::uintmax_t>((value - static_cast<T>(integral)) * scale + T(0.5));
+    if (fraction >= scale) {
+        ++integral;
+        fraction -= scale;
+    }
+    size += formatDigits(out + size, integral);
+
+    std::size_t digits = t_precision;
+    while (digits > 0 && fraction % 10 == 0) {
+        fraction /= 10;
+        --digits;
+    }
+    if (digits > 0) {
+        out[size++] = '.';
+        size += formatDigits(out + size, fraction, digits);
+    }
+    return size;
+}
+
+// Everything here is consteval, pieces() may only be called from immediate functions.
+class SchemaWriter {
+private:
+    char* const m_begin;
+    char* m_out;
+
+    template <typename... Pieces, std::size_t... Is>
+    consteval void writeAll(const std::tuple<Pieces...>& pieces, std::index_sequence<Is...>) {
+        (write(std::get<Is>(pieces)), ...);
+    }
+
+    template <std::size_t t_indent, typename... Items, std::size_t... Is>
+    consteval void writeLines(const std::tuple<Items...>& items, std::index_sequence<Is...>) {
+        (writeLine<t_indent>(std::get<Is>(items), Is + 1 == sizeof...(Items)), ...);
+    }
+
+    template <std::size_t t_indent, typename T>
+    consteval void writeLine(const T& item, bool last) {
+        write(item.template pieces<t_indent>());
+        if (!last)
+            *m_out++ = ',';
+        *m_out++ = '\n';
+    }
+
+public:
+    consteval explicit SchemaWriter(char* out)
+        : m_begin(out)
+        , m_out(out) {}
+
+    consteval std::size_t written() const { return static_cast<std::size_t>(m_out - m_begin); }
+
+    template <std::size_t N>
+    consteval void write(const fixed_string<N>& piece) {
+        for (char c : piece.view())
+            *m_out++ = c;
+    }
+
+    template <std::size_t t_indent>
+    consteval void write(Indent<t_indent>) {
+        for (std::size_t i = 0; i < 2 * t_indent; ++i)
+            *m_out++ = ' ';
+    }
+
+    template <std::size_t t_width, typename T>
+    consteval void write(const Decimal<t_width, T>& piece) {
+        char digits[64] {};
+        std::size_t size = formatDecimal(digits, piece.value);
+        if (size > t_width)
+            throw std::length_error("Number does not fit into the requested width");
+        for (std::size_t i = 0; i < size; ++i)
+            *m_out++ = digits[i];
+    }
+
+    template <typename Tuple>
+    consteval void write(const Conditional<Tuple>& piece) {
+        if (piece.present)
+            write(piece.pieces);
+    }
+
+    template <typename... Pieces>
+    consteval void write(const std::tuple<Pieces...>& pieces) {
+        writeAll(pieces, std::index_sequence_for<Pieces...>());
+    }
+
+    template <std::size_t t_indent, typename T>
+    consteval void write(const Nested<t_indent, T>& piece) {
+        write(piece.value.template pieces<t_indent>());
+    }
+
+    template <std::size_t t_indent, typename... Items>
+    consteval void write(const NestedList<t_indent, std::tuple<Items...>>& piece) {
+        writeLines<t_indent + 1>(piece.values, std::index_sequence_for<Items...>());
+    }
+};
+
+/**
+ * An encoded schema. The capacity is the longest the pieces can get, the
+ * view covers only what was written, which leaves out unset limits and
+ * digits a number did not need.
+ */
+template <std::size_t t_capacity>
+class Encoded {
+private:
+    char m_data[t_capacity + 1] {};
+    std::size_t m_size = 0;
+
+public:
+    consteval Encoded(const char* data, std::size_t size)
+        : m_size(size) {
+        std::copy_n(data, size, m_data);
+    }
+
+    constexpr std::string_view view() const noexcept { return { m_data, m_size }; }
+    constexpr std::size_t size() const noexcept { return m_size; }
+    static constexpr std::size_t capacity() noexcept { return t_capacity; }
+};
 
-    return to_string<N - 1>(value / 10) + fixed_string<N>(1, '0' + value % 10);
+template <typename... Pieces>
+consteval auto encodePieces(const std::tuple<Pieces...>& pieces) {
+    constexpr std::size_t capacity = PieceSize<std::tuple<Pieces...>>::value;
+    char buffer[capacity + 1] {};
+    SchemaWriter writer(buffer);
+    writer.write(pieces);
+    return Encoded<capacity>(buffer, writer.written());
 }
 
-} // namespace tet
\ No newline at end of file
+} // namespace tet
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace Benchmark {
+
+static constexpr const char* s_tag = "Benchmark";
+
+// Keeps the compiler from dropping a result that is otherwise unused.
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Average time of one call in nanoseconds. A tenth of the iterations runs first as a warm-up.
+template <typename Fn>
+double measure(std::size_t iterations, Fn&& fn) {
+    for (std::size_t i = 0; i < iterations / 10; ++i)
+        fn();
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i)
+        fn();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+void serialization();
+void schema();
+void topics();
+void client();
+
+} // namespace Benchmark
@@ -0,0 +1,100 @@
+#include "benchmark.hpp"
+
+#include "tet/Client.hpp"
+#include "tet/Field.hpp"
+#include "tet/LoopbackTransport.hpp"
+
+#include "esp_log.h"
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <tuple>
+
+namespace {
+
+constexpr std::size_t s_iterations = 20000;
+
+struct State {
+    std::chrono::steady_clock::time_point time;
+    int level = 0;
+};
+
+struct Manager {
+    using StateType = State;
+
+    State state;
+
+    State get() const { return state; }
+    void apply(const State& next) { state = next; }
+};
+
+constexpr tet::Number level("level", "Level", true, 0, 255);
+constexpr tet::Command setLevel("setLevel", "Set Level", std::make_tuple(level),
+    tet::Callback<State>(+[](const State& state, const nlohmann::json& args) {
+        State next = state;
+        next.level = args["level"];
+        return next;
+    }));
+constexpr auto commands = std::make_tuple(setLevel);
+constexpr auto events = std::make_tuple();
+constexpr auto fields = std::make_tuple(tet::Field(&State::level, level));
+
+} // namespace
+
+namespace Benchmark {
+
+// A command delivered as if from the controller, handled and answered with its state delta, all in the calling thread.
+void client() {
+    static constexpr auto schema = tet::makeSchema(commands, events, fields);
+    static auto callbacks = tet::makeFrozenMap<State>(commands);
+    static constexpr auto opcodes = tet::makeDispatchTable<State>(commands);
+
+    std::size_t deltas = 0;
+    tet::LoopbackTransport transport([&](const tet::Frame& frame, const tet::Delivery&) {
+        deltas += frame.topic.ends_with("/delta");
+    });
+    Manager manager;
+    tet::Client<State, Manager, tet::LoopbackTransport, 1, std::decay_t<decltype(fields)>> client("bench", schema.view(), callbacks, opcodes, fields);
+    client.init(&transport, &manager);
+    transport.connect();
+
+    // The level changes every time, so every command publishes a delta.
+    const std::string topic = "tet/devices/bench/commands";
+    std::string byName[2] = {
+        R"({"command":"setLevel","data":{"level":1}})",
+        R"({"command":"setLevel","data":{"level":2}})",
+    };
+    std::string byOpcode[2] = {
+        R"({"command":0,"data":{"level":1}})",
+        R"({"command":0,"data":{"level":2}})",
+    };
+    std::string compound[2] = {
+        R"([{"command":0,"data":{"level":1}},{"command":0,"data":{"level":2}},{"command":0,"data":{"level":3}},{"command":0,"data":{"level":4}}])",
+        R"([{"command":0,"data":{"level":4}},{"command":0,"data":{"level":3}},{"command":0,"data":{"level":2}},{"command":0,"data":{"level":1}}])",
+    };
+
+    std::size_t next = 0;
+    auto run = [&](std::string* payloads) {
+        deltas = 0;
+        next = 0;
+        double ns = measure(s_iterations, [&] {
+            bool delivered = transport.deliver(topic, payloads[next++ & 1]);
+            keep(delivered);
+        });
+        return std::make_pair(ns, deltas);
+    };
+
+    auto [nameNs, nameDeltas] = run(byName);
+    auto [opcodeNs, opcodeDeltas] = run(byOpcode);
+    auto [compoundNs, compoundDeltas] = run(compound);
+    std::size_t expected = s_iterations + s_iterations / 10;
+
+    ESP_LOGI(s_tag, "Loopback command by name, to delta:   %8.0f ns/command", nameNs);
+    ESP_LOGI(s_tag, "Loopback command by opcode, to delta: %8.0f ns/command", opcodeNs);
+    ESP_LOGI(s_tag, "Loopback compound of 4, to delta:     %8.0f ns/compound", compoundNs);
+    if (nameDeltas != expected || opcodeDeltas != expected || compoundDeltas != expected)
+        ESP_LOGE(s_tag, "Expected %zu deltas per run, got %zu, %zu and %zu", expected, nameDeltas, opcodeDeltas, compoundDeltas);
+}
+
+} // namespace Benchmark
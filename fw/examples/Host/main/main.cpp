@@ -1,5 +1,8 @@
 #include "Logger/Log.hpp"
 
+#include "benchmark.hpp"
+#include "test.hpp"
+
 struct Tag {
     static constexpr std::string_view name = "Tag";
     static constexpr LogLevel maxLevel = LogLevel::Debug;
@@ -11,4 +14,16 @@ extern "C" void app_main(void) {
     Log<Tag>::info("Info");
     Log<Tag>::debug("Debug");
     Log<Tag>::verbose("Verbose");
+
+    Test::multicast();
+    Test::udp();
+    if (Test::failures())
+        ESP_LOGE(Test::s_tag, "%zu checks failed", Test::failures());
+    else
+        ESP_LOGI(Test::s_tag, "All checks passed");
+
+    Benchmark::serialization();
+    Benchmark::schema();
+    Benchmark::topics();
+    Benchmark::client();
 }
@@ -0,0 +1,189 @@
+#include "test.hpp"
+
+#include "tet/Multicast.hpp"
+
+#include "esp_log.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+using namespace tet::Multicast;
+using Order = Sequence::Order;
+
+namespace {
+
+struct Rgb {
+    std::uint8_t r = 0;
+    std::uint8_t g = 0;
+    std::uint8_t b = 0;
+
+    Rgb() = default;
+    Rgb(std::uint8_t r, std::uint8_t g, std::uint8_t b)
+        : r(r)
+        , g(g)
+        , b(b) {}
+};
+
+sockaddr_in source(const char* address, std::uint16_t port) {
+    sockaddr_in source = {};
+    source.sin_family = AF_INET;
+    source.sin_port = htons(port);
+    inet_aton(address, &source.sin_addr);
+    return source;
+}
+
+std::string frame(std::uint32_t sequence, std::uint16_t first = 0, std::uint8_t session = 0) {
+    return encode({ Type::Frame, sequence, 1, s_allStations, first, session }, std::string("\x01\x02\x03", 3));
+}
+
+void sequence() {
+    Sequence ordered;
+    TEST_CHECK(ordered.feed(10) == Order::InOrder);
+    TEST_CHECK(ordered.feed(11) == Order::InOrder);
+    TEST_CHECK(ordered.feed(14) == Order::Ahead);
+    TEST_CHECK(ordered.stats().lost == 2);
+    TEST_CHECK(ordered.feed(12) == Order::Late);
+    TEST_CHECK(ordered.stats().lost == 1);
+    TEST_CHECK(ordered.feed(12) == Order::Duplicate);
+    TEST_CHECK(ordered.feed(14) == Order::Duplicate);
+    TEST_CHECK(ordered.feed(14 + Sequence::s_window + 5) == Order::Ahead);
+    TEST_CHECK(ordered.feed(13) == Order::Stale);
+    TEST_CHECK(ordered.stats().duplicates == 2);
+
+    // The edge of the window is still remembered.
+    Sequence window;
+    window.feed(0);
+    TEST_CHECK(window.feed(Sequence::s_window) == Order::Ahead);
+    TEST_CHECK(window.feed(0) == Order::Duplicate);
+    TEST_CHECK(window.feed(1) == Order::Late);
+
+    Sequence wrap;
+    wrap.feed(0xFFFFFFF0u);
+    TEST_CHECK(wrap.feed(0xFFFFFFF1u) == Order::InOrder);
+    TEST_CHECK(wrap.feed(1) == Order::Ahead);
+    TEST_CHECK(wrap.feed(0xFFFFFFFFu) == Order::Late);
+    TEST_CHECK(wrap.feed(0) == Order::Late);
+    TEST_CHECK(wrap.stats().lost == 13);
+
+    // A new session restarts the sequence, however close the numbers are.
+    Sequence session;
+    session.feed(500, 7);
+    TEST_CHECK(session.feed(3, 9) == Order::InOrder);
+    TEST_CHECK(session.feed(4, 9) == Order::InOrder);
+    TEST_CHECK(session.stats().restarts == 1);
+
+    // Senders that keep session 0 only restart far behind.
+    Sequence legacy;
+    legacy.feed(500);
+    TEST_CHECK(legacy.feed(3) == Order::Stale);
+    legacy.feed(5000);
+    TEST_CHECK(legacy.feed(0) == Order::InOrder);
+    TEST_CHECK(legacy.stats().restarts == 1);
+
+    auto header = decode(encode({ Type::Cue, 1, 1, s_allStations, 2, 42 }, ""));
+    TEST_CHECK(header && header->session == 42 && header->argument == 2);
+    TEST_CHECK(!decode("junk"));
+}
+
+void senders() {
+    std::array<Rgb, 4> leds {};
+    std::size_t frames = 0;
+    Listener<Rgb> listener({ .groups = 1 }, leds, [&](std::size_t, std::size_t) { ++frames; });
+
+    // Senders keep their own sequences, call them A (10.0.0.1:1000) and B (10.0.0.2:1000).
+    listener.handle(frame(100), source("10.0.0.1", 1000));
+    listener.handle(frame(5), source("10.0.0.2", 1000));
+    listener.handle(frame(6), source("10.0.0.2", 1000));
+    listener.handle(frame(99), source("10.0.0.1", 1000));
+    TEST_CHECK(frames == 3);
+
+    // A restarted sender on a new port starts over.
+    listener.handle(frame(1), source("10.0.0.1", 1001));
+    TEST_CHECK(frames == 4);
+
+    // A third sender makes s_maxSenders, after B is heard again 10.0.0.1:1000 is the one heard least recently.
+    static_assert(Listener<Rgb>::s_maxSenders == 4);
+    listener.handle(frame(1), source("10.0.0.3", 1000));
+    listener.handle(frame(7), source("10.0.0.2", 1000));
+    TEST_CHECK(frames == 6);
+    // A fifth sender replaces it.
+    listener.handle(frame(1), source("10.0.0.4", 1000));
+    TEST_CHECK(frames == 7);
+    // So its late frame starts a new sequence, while B still drops a duplicate.
+    listener.handle(frame(98), source("10.0.0.1", 1000));
+    listener.handle(frame(7), source("10.0.0.2", 1000));
+    TEST_CHECK(frames == 8);
+
+    auto stats = listener.stats();
+    TEST_CHECK(stats.received == 10);
+    TEST_CHECK(stats.duplicates == 1);
+    // The late frame of the evicted sender is still counted.
+    TEST_CHECK(stats.reordered == 1);
+}
+
+void loopback() {
+    std::array<Rgb, 10> leds {};
+    std::size_t frames = 0;
+    std::size_t cues = 0;
+    Listener<Rgb> listener({ .interface = "127.0.0.1", .groups = 2, .station = 5 }, leds,
+        [&](std::size_t, std::size_t) { ++frames; },
+        [&](std::uint16_t, std::string_view) { ++cues; });
+    try {
+        listener.start();
+    } catch (const std::exception& e) {
+        TEST_CHECK(!"listener joined on 127.0.0.1");
+        ESP_LOGE(Test::s_tag, "%s", e.what());
+        return;
+    }
+
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    in_addr loopbackInterface = {};
+    inet_aton("127.0.0.1", &loopbackInterface);
+    unsigned char loop = 1;
+    setsockopt(sender, IPPROTO_IP, IP_MULTICAST_IF, &loopbackInterface, sizeof(loopbackInterface));
+    setsockopt(sender, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    sockaddr_in group = source("239.0.84.1", 47810);
+    auto send = [&](const std::string& packet) {
+        sendto(sender, packet.data(), packet.size(), 0, reinterpret_cast<const sockaddr*>(&group), sizeof(group));
+    };
+
+    send(encode({ Type::Frame, 1, 2, s_allStations, 8 }, std::string("\x01\x02\x03\x04\x05\x06\x07\x08\x09", 9)));
+    send(encode({ Type::Cue, 3, 1, s_allStations, 7 }, "x")); // Another group.
+    send(encode({ Type::Cue, 4, 2, 6, 7 }, "x")); // Another station.
+    send(encode({ Type::Cue, 5, 2, 5, 7 }, "{}"));
+    send(encode({ Type::Frame, 2, 2, 5, 0 }, "\x0a\x0b\x0c")); // Late.
+    send("junk");
+
+    for (int i = 0; i < 50 && listener.stats().received < 6; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    listener.stop();
+    close(sender);
+
+    auto stats = listener.stats();
+    TEST_CHECK(stats.received == 6);
+    TEST_CHECK(frames == 1 && cues == 1);
+    TEST_CHECK(stats.ignored == 2 && stats.malformed == 1 && stats.reordered == 1);
+    TEST_CHECK(leds[8].r == 1 && leds[9].b == 6 && leds[0].r == 0);
+}
+
+} // namespace
+
+namespace Test {
+
+void multicast() {
+    std::size_t before = failures();
+    sequence();
+    senders();
+    loopback();
+    ESP_LOGI(s_tag, "Multicast: %zu failed checks", failures() - before);
+}
+
+} // namespace Test
@@ -0,0 +1,68 @@
+/**
+ * Build-time benchmark of the schema builder. The definition below has 50
+ * commands with arguments nested three Objects deep, which is well beyond any
+ * of the example devices. Its cost is paid by the compiler, so the number to
+ * watch is the compile time of this file, e.g.
+ *
+ *     time xtensa-esp32-elf-g++ -std=c++23 -fconstexpr-ops-limit=50000000 -c schema.cpp ...
+ *
+ * or the "constexpr evaluation" line of -ftime-report. At run time only the
+ * size of the encoded schema is logged.
+ */
+#include "benchmark.hpp"
+
+#include "tet/Argument.hpp"
+#include "tet/Client.hpp"
+#include "tet/Command.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include "esp_log.h"
+
+#include <chrono>
+#include <tuple>
+
+namespace {
+
+struct State {
+    std::chrono::steady_clock::time_point time;
+    int value;
+};
+
+constexpr tet::Number red("r", "Red", true, 0, 255);
+constexpr tet::Number green("g", "Green", true, 0, 255);
+constexpr tet::Number blue("b", "Blue", true, 0, 255);
+constexpr tet::String label("label", "Label", false, 1, 32);
+constexpr tet::Boolean enabled("enabled", "Enabled", true);
+
+constexpr tet::Object color("color", "Color", true, std::make_tuple(red, green, blue));
+constexpr tet::Array colors("colors", "Colors", true, color, 1, 60);
+constexpr tet::Object segment("segment", "Segment", true, std::make_tuple(colors, label, enabled));
+constexpr tet::Object layout("layout", "Layout", true, std::make_tuple(segment, color, label));
+
+constexpr tet::Callback<State> callback(+[](const State& state, const nlohmann::json&) { return state; });
+
+#define BENCHMARK_COMMAND(n) tet::Command("command" #n, "Command " #n, std::make_tuple(layout, enabled), callback)
+#define BENCHMARK_COMMANDS_10(n)                                                                 \
+    BENCHMARK_COMMAND(n##0), BENCHMARK_COMMAND(n##1), BENCHMARK_COMMAND(n##2),                   \
+        BENCHMARK_COMMAND(n##3), BENCHMARK_COMMAND(n##4), BENCHMARK_COMMAND(n##5),               \
+        BENCHMARK_COMMAND(n##6), BENCHMARK_COMMAND(n##7), BENCHMARK_COMMAND(n##8),               \
+        BENCHMARK_COMMAND(n##9)
+
+constexpr auto commands = std::make_tuple(
+    BENCHMARK_COMMANDS_10(0), BENCHMARK_COMMANDS_10(1), BENCHMARK_COMMANDS_10(2),
+    BENCHMARK_COMMANDS_10(3), BENCHMARK_COMMANDS_10(4));
+
+constexpr auto events = std::make_tuple();
+
+constexpr auto s_schema = tet::makeSchema(commands, events);
+
+} // namespace
+
+namespace Benchmark {
+
+void schema() {
+    ESP_LOGI(s_tag, "schema of %zu commands: %zu B", std::tuple_size_v<decltype(commands)>, s_schema.view().size());
+}
+
+} // namespace Benchmark
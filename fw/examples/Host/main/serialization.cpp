@@ -0,0 +1,138 @@
+#include "benchmark.hpp"
+
+#include "tet/Serialization.hpp"
+
+#include <glaze/glaze.hpp>
+#include <nlohmann/json.hpp>
+
+#include "esp_log.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Same shape as the Lantern state and its showTop command.
+struct Pixel {
+    std::uint8_t r;
+    std::uint8_t g;
+    std::uint8_t b;
+};
+
+struct State {
+    std::array<Pixel, 60> top;
+    std::array<Pixel, 52> perim;
+    std::array<bool, 4> doors;
+    bool shutdown;
+};
+
+struct ColorsArgs {
+    std::vector<Pixel> colors;
+};
+
+struct ShowCommand {
+    std::string command;
+    ColorsArgs data;
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Pixel, r, g, b)
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(State, top, perim, doors, shutdown)
+
+constexpr std::size_t s_iterations = 20000;
+
+State makeState() {
+    State state {};
+    for (std::size_t i = 0; i < state.top.size(); ++i)
+        state.top[i] = { static_cast<std::uint8_t>(i), static_cast<std::uint8_t>(255 - i), 128 };
+    for (std::size_t i = 0; i < state.perim.size(); ++i)
+        state.perim[i] = { 12, static_cast<std::uint8_t>(i), static_cast<std::uint8_t>(3 * i) };
+    state.doors = { true, false, true, false };
+    return state;
+}
+
+std::string makeCommand() {
+    nlohmann::json colors = nlohmann::json::array();
+    for (int i = 0; i < 60; ++i)
+        colors.push_back({ { "r", i }, { "g", 255 - i }, { "b", 128 } });
+    return nlohmann::json { { "command", "showTop" }, { "data", { { "colors", colors } } } }.dump();
+}
+
+void stateSerialization() {
+    const State state = makeState();
+    std::string out;
+
+    double nlohmannNs = Benchmark::measure(s_iterations, [&] {
+        out = nlohmann::json(state).dump();
+        Benchmark::keep(out);
+    });
+    std::size_t nlohmannBytes = out.size();
+
+    double jsonNs = Benchmark::measure(s_iterations, [&] {
+        out.clear();
+        tet::serialize<tet::Format::Json>(state, out);
+        Benchmark::keep(out);
+    });
+    std::size_t jsonBytes = out.size();
+
+    double beveNs = Benchmark::measure(s_iterations, [&] {
+        out.clear();
+        tet::serialize<tet::Format::Beve>(state, out);
+        Benchmark::keep(out);
+    });
+    std::size_t beveBytes = out.size();
+
+    ESP_LOGI(Benchmark::s_tag, "state nlohmann json: %8.0f ns, %zu B", nlohmannNs, nlohmannBytes);
+    ESP_LOGI(Benchmark::s_tag, "state glaze json:    %8.0f ns, %zu B", jsonNs, jsonBytes);
+    ESP_LOGI(Benchmark::s_tag, "state glaze beve:    %8.0f ns, %zu B", beveNs, beveBytes);
+}
+
+void commandArguments() {
+    const std::string payload = makeCommand();
+    const nlohmann::json parsed = nlohmann::json::parse(payload);
+    const nlohmann::json& data = parsed["data"];
+
+    // Client parses every command with nlohmann before validating it, this part is shared.
+    double parseNs = Benchmark::measure(s_iterations, [&] {
+        auto json = nlohmann::json::parse(payload);
+        Benchmark::keep(json);
+    });
+
+    double manualNs = Benchmark::measure(s_iterations, [&] {
+        ColorsArgs args;
+        for (const auto& color : data["colors"])
+            args.colors.push_back({ color["r"].get<std::uint8_t>(), color["g"].get<std::uint8_t>(), color["b"].get<std::uint8_t>() });
+        Benchmark::keep(args);
+    });
+
+    double typedNs = Benchmark::measure(s_iterations, [&] {
+        ColorsArgs args;
+        tet::fromJson(data, args);
+        Benchmark::keep(args);
+    });
+
+    // The alternative of reading the raw payload with glaze, skipping nlohmann entirely.
+    double glazeNs = Benchmark::measure(s_iterations, [&] {
+        ShowCommand command;
+        auto error = glz::read_json(command, payload);
+        Benchmark::keep(error);
+        Benchmark::keep(command);
+    });
+
+    ESP_LOGI(Benchmark::s_tag, "command nlohmann parse (%zu B): %8.0f ns", payload.size(), parseNs);
+    ESP_LOGI(Benchmark::s_tag, "command manual arguments:      %8.0f ns", manualNs);
+    ESP_LOGI(Benchmark::s_tag, "command tet::fromJson:         %8.0f ns", typedNs);
+    ESP_LOGI(Benchmark::s_tag, "command glaze read_json:       %8.0f ns", glazeNs);
+}
+
+} // namespace
+
+namespace Benchmark {
+
+void serialization() {
+    stateSerialization();
+    commandArguments();
+}
+
+} // namespace Benchmark
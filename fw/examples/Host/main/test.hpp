@@ -0,0 +1,33 @@
+#pragma once
+
+#include "esp_log.h"
+
+#include <cstddef>
+
+/**
+ * Checks run on the host build, next to the benchmarks. A failed check is
+ * logged with its location and counted, the remaining checks still run.
+ */
+namespace Test {
+
+static constexpr const char* s_tag = "Test";
+
+inline std::size_t& failures() {
+    static std::size_t s_failures = 0;
+    return s_failures;
+}
+
+inline bool check(bool condition, const char* expression, const char* file, int line) {
+    if (!condition) {
+        ++failures();
+        ESP_LOGE(s_tag, "%s:%d: check failed: %s", file, line, expression);
+    }
+    return condition;
+}
+
+void multicast();
+void udp();
+
+} // namespace Test
+
+#define TEST_CHECK(condition) ::Test::check((condition), #condition, __FILE__, __LINE__)
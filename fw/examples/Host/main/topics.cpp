@@ -0,0 +1,92 @@
+#include "benchmark.hpp"
+
+#include "TopicRouter.hpp"
+
+#include "esp_log.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t s_subscriptions = 1000;
+constexpr std::size_t s_iterations = 100000;
+
+// tet device topics, each device subscribed to its commands.
+std::string deviceTopic(std::size_t i) {
+    return "tet/devices/" + std::to_string(i) + "/commands";
+}
+
+void exact() {
+    MQTT::TopicRouter router;
+    std::vector<std::string> topics;
+    for (std::size_t i = 0; i < s_subscriptions; ++i) {
+        topics.push_back(deviceTopic(i));
+        router.add(topics.back(), [](MQTT::Event::Data) {});
+    }
+
+    std::size_t next = 0;
+    double routerNs = Benchmark::measure(s_iterations, [&] {
+        auto count = router.dispatch(topics[next], nullptr);
+        Benchmark::keep(count);
+        next = (next + 7) % topics.size();
+    });
+
+    // What every message cost before the router, one string compare per subscription.
+    next = 0;
+    double linearNs = Benchmark::measure(s_iterations / 10, [&] {
+        std::size_t count = 0;
+        for (const auto& topic : topics)
+            count += topic == topics[next];
+        Benchmark::keep(count);
+        next = (next + 7) % topics.size();
+    });
+
+    ESP_LOGI(Benchmark::s_tag, "%zu exact subscriptions, router: %8.0f ns/message", s_subscriptions, routerNs);
+    ESP_LOGI(Benchmark::s_tag, "%zu exact subscriptions, linear: %8.0f ns/message", s_subscriptions, linearNs);
+}
+
+void wildcards() {
+    MQTT::TopicRouter router;
+    std::vector<std::string> topics;
+    for (std::size_t i = 0; i < s_subscriptions; ++i) {
+        topics.push_back(deviceTopic(i));
+        switch (i % 4) {
+        case 0:
+            router.add(topics.back(), [](MQTT::Event::Data) {});
+            break;
+        case 1:
+            router.add("tet/devices/" + std::to_string(i) + "/+", [](MQTT::Event::Data) {});
+            break;
+        case 2:
+            router.add("tet/devices/" + std::to_string(i) + "/#", [](MQTT::Event::Data) {});
+            break;
+        default:
+            router.add("tet/+/" + std::to_string(i) + "/commands", [](MQTT::Event::Data) {});
+            break;
+        }
+    }
+    router.add("tet/devices/+/commands", [](MQTT::Event::Data) {});
+    router.add("#", [](MQTT::Event::Data) {});
+
+    std::size_t next = 0;
+    double routerNs = Benchmark::measure(s_iterations, [&] {
+        auto count = router.dispatch(topics[next], nullptr);
+        Benchmark::keep(count);
+        next = (next + 7) % topics.size();
+    });
+
+    ESP_LOGI(Benchmark::s_tag, "%zu mixed wildcard subscriptions, router: %8.0f ns/message", router.size(), routerNs);
+}
+
+} // namespace
+
+namespace Benchmark {
+
+void topics() {
+    exact();
+    wildcards();
+}
+
+} // namespace Benchmark
@@ -0,0 +1,126 @@
+#include "test.hpp"
+
+#include "tet/UdpTransport.hpp"
+
+#include "esp_log.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::uint16_t s_transportPort = 47900;
+constexpr std::uint16_t s_peerPort = 47901;
+constexpr std::size_t s_maxDatagram = 64;
+
+sockaddr_in address(const char* host, std::uint16_t port) {
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_aton(host, &address.sin_addr);
+    return address;
+}
+
+// A socket sending from host, e.g. the peer or another host on the loopback network.
+int bound(const char* host, std::uint16_t port) {
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in local = address(host, port);
+    if (bind(sender, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0) {
+        close(sender);
+        return -1;
+    }
+    timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+    setsockopt(sender, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sender;
+}
+
+std::string datagram(std::string_view topic, std::string_view payload) {
+    return static_cast<char>(topic.size()) + std::string(topic) + std::string(payload);
+}
+
+} // namespace
+
+namespace Test {
+
+void udp() {
+    std::size_t before = failures();
+
+    tet::UdpTransport transport({
+        .peer = "127.0.0.1",
+        .peerPort = s_peerPort,
+        .localPort = s_transportPort,
+        .maxDatagram = s_maxDatagram,
+    });
+
+    std::mutex mutex;
+    std::vector<std::string> received;
+    transport.attach(tet::TransportEvents {
+        .message = [&](const tet::Frame& frame) {
+            std::lock_guard lock(mutex);
+            received.emplace_back(frame.payload);
+        },
+        .connected = [] {},
+        .disconnected = [] {},
+    });
+    transport.start();
+    transport.subscribe("t", {});
+
+    int peer = bound("127.0.0.1", s_peerPort);
+    int stranger = bound("127.0.0.2", 0);
+    TEST_CHECK(peer >= 0 && stranger >= 0);
+    sockaddr_in to = address("127.0.0.1", s_transportPort);
+    auto send = [&](int from, const std::string& data) {
+        sendto(from, data.data(), data.size(), 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to));
+    };
+
+    send(peer, datagram("t", "from the peer"));
+    send(stranger, datagram("t", "spoofed"));
+    send(peer, std::string("\0t", 2)); // Empty topic.
+    send(peer, std::string("\xC8topic", 6)); // Topic past the end.
+    send(peer, datagram("t", std::string(s_maxDatagram, 'x'))); // Over maxDatagram, would arrive cut.
+    send(peer, datagram("u", "unsubscribed"));
+
+    auto settled = [&] {
+        auto stats = transport.stats();
+        return stats.received + stats.foreign + stats.malformed + stats.unsubscribed >= 6;
+    };
+    for (int i = 0; i < 50 && !settled(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    auto stats = transport.stats();
+    TEST_CHECK(stats.received == 1);
+    TEST_CHECK(stats.foreign == 1);
+    TEST_CHECK(stats.malformed == 3);
+    TEST_CHECK(stats.unsubscribed == 1);
+    {
+        std::lock_guard lock(mutex);
+        TEST_CHECK(received.size() == 1 && received.front() == "from the peer");
+    }
+
+    // Publishing: oversized and empty topics are dropped, the rest reaches the peer.
+    TEST_CHECK(!transport.publish("t", std::string(s_maxDatagram, 'x'), {}));
+    TEST_CHECK(!transport.publish("", "x", {}));
+    TEST_CHECK(transport.publish("t", "to the peer", {}));
+    stats = transport.stats();
+    TEST_CHECK(stats.dropped == 2 && stats.sent == 1);
+
+    char buffer[s_maxDatagram + 1];
+    ssize_t length = recv(peer, buffer, sizeof(buffer), 0);
+    TEST_CHECK(length > 0 && std::string(buffer, length) == datagram("t", "to the peer"));
+
+    transport.stop();
+    close(peer);
+    close(stranger);
+    ESP_LOGI(s_tag, "UDP transport: %zu failed checks", failures() - before);
+}
+
+} // namespace Test
@@ -22,6 +22,8 @@ SOFTWARE. */
 
 #pragma once
 
+#include "Function/InplaceFunction.hpp"
+
 #include <esp_timer.h>
 
 #include <memory>
@@ -37,6 +39,8 @@ class Timers {
 public:
     static constexpr uint16_t INVALID_ID = 0;
 
+    using Callback = Function::InplaceFunction<bool()>;
+
     /**
      * \brief  If you don't plan to use FreeRTOS SW timers, call this to free up 2KB of heap
      */
@@ -53,7 +57,7 @@ public:
      * \param callback is a function which will be schedule with the set period.
      * \return timer ID that you can use to cancel the timer.
      */
-    uint16_t schedule(uint32_t period_ms, std::function<bool()> callback);
+    uint16_t schedule(uint32_t period_ms, Callback callback);
 
     bool reset(uint16_t id, uint32_t period_ms);
     bool cancel(uint16_t id);
@@ -64,12 +68,12 @@ public:
 
 private:
     struct timer_t {
-        std::function<bool()> callback;
+        Callback callback;
         esp_timer_handle_t handle;
         uint16_t id;
 
         void swap(timer_t& o) {
-            callback.swap(o.callback);
+            std::swap(callback, o.callback);
             std::swap(handle, o.handle);
             std::swap(id, o.id);
         }
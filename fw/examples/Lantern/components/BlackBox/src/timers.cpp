@@ -64,7 +64,7 @@ void Timers::timerCallback(void* idVoid) {
     }
 }
 
-uint16_t Timers::schedule(uint32_t period_ms, std::function<bool()> callback) {
+uint16_t Timers::schedule(uint32_t period_ms, Callback callback) {
     std::lock_guard<std::recursive_mutex> l(m_mutex);
 
     const auto id = getFreeIdLocked();
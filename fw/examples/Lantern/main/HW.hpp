@@ -5,6 +5,8 @@
 
 #include "esp_log.h"
 
+#include <glaze/glaze.hpp>
+
 #include <chrono>
 #include <utility>
 #include <array>
@@ -17,6 +19,19 @@ struct State {
     bool shutdown = false;
 };
 
+template <>
+struct glz::meta<Rgb> {
+    using T = Rgb;
+    static constexpr auto value = glz::object("r", &T::r, "g", &T::g, "b", &T::b);
+};
+
+// time is local to the device, so it is not part of the published state
+template <>
+struct glz::meta<State> {
+    using T = State;
+    static constexpr auto value = glz::object("top", &T::top, "perim", &T::perim, "doors", &T::doors, "shutdown", &T::shutdown);
+};
+
 class Manager {
 private:
     BlackBox::Manager& m_blackBox;
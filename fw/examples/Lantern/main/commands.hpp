@@ -2,14 +2,16 @@
 
 #include "HW.hpp"
 
-#include "tet/Command.hpp"
 #include "tet/Argument.hpp"
+#include "tet/Command.hpp"
+#include "tet/Serialization.hpp"
 
 #include <nlohmann/json.hpp>
 #include <Color.h>
 
 #include "esp_log.h"
 
+#include <cstdint>
 #include <tuple>
 #include <vector>
 
@@ -17,104 +19,108 @@ namespace Commands {
 
 static const char* TAG = "commands";
 
-constexpr tet::Number red("r", "Red", true);
-constexpr tet::Number green("g", "Green", true);
-constexpr tet::Number blue("b", "Blue", true);
+constexpr tet::Number red("r", "Red", true, 0, 255);
+constexpr tet::Number green("g", "Green", true, 0, 255);
+constexpr tet::Number blue("b", "Blue", true, 0, 255);
 
-constexpr tet::Number index("index", "Index", true);
+constexpr tet::Number index("index", "Index", true, 0, 3);
 
 constexpr tet::Object color("color", "Color", true, std::make_tuple(red, green, blue));
 constexpr tet::Array colorsTop("colors", "Colors", true, color, 60, 60);
 constexpr tet::Array colorsPerim("colors", "Colors", true, color, 52, 52);
 
-static inline Rgb parseColor(const nlohmann::json& args) {
-    ESP_LOGI(TAG, "%s", args.dump().c_str());
-    return Rgb(args["r"].get<int>(), args["g"].get<int>(), args["b"].get<int>());
-}
+struct Color {
+    std::uint8_t r;
+    std::uint8_t g;
+    std::uint8_t b;
 
-static inline int parseIndex(const nlohmann::json& args) {
-    return args["index"].get<int>();
-}
+    operator Rgb() const { return Rgb(r, g, b); }
+};
 
-static inline std::vector<Rgb> parseColors(const nlohmann::json& args) {
-    std::vector<Rgb> colors;
-    for (const auto& color : args) {
-        colors.push_back(parseColor(color));
-    }
-    return colors;
-}
+struct IndexArgs {
+    int index;
+};
 
-constexpr tet::Command openDoor("openDoor", "Open Door", std::make_tuple(index), tet::Callback<State>(+[](const State& state, const nlohmann::json& args) {
+struct ColorArgs {
+    Color color;
+};
+
+struct ColorsArgs {
+    std::vector<Color> colors;
+};
+
+static inline State openDoorImpl(const State& state, const IndexArgs& args) {
     State newState = state;
-    int index = parseIndex(args);
-    ESP_LOGI(TAG, "openDoor: %i", index);
-    BlackBox::Manager::singleton().door(index).open();
-    newState.doors[index] = true;
+    ESP_LOGI(TAG, "openDoor: %i", args.index);
+    BlackBox::Manager::singleton().door(args.index).open();
+    newState.doors[args.index] = true;
     return newState;
-}));
+}
 
-constexpr tet::Command closeDoor("closeDoor", "Close Door", std::make_tuple(index), tet::Callback<State>(+[](const State& state, const nlohmann::json& args) {
+static inline State closeDoorImpl(const State& state, const IndexArgs& args) {
     State newState = state;
-    int index = parseIndex(args);
-    ESP_LOGI(TAG, "closeDoor: %i", index);
-    BlackBox::Manager::singleton().door(index).close();
-    newState.doors[index] = false;
+    ESP_LOGI(TAG, "closeDoor: %i", args.index);
+    BlackBox::Manager::singleton().door(args.index).close();
+    newState.doors[args.index] = false;
     return newState;
-}));
+}
 
-constexpr tet::Command fillTop("fillTop", "Fill Top", std::make_tuple(color), tet::Callback<State>(+[](const State& state, const nlohmann::json& args) {
+static inline State fillTopImpl(const State& state, const ColorArgs& args) {
     State newState = state;
-    Rgb color = parseColor(args["color"]);
-    BlackBox::Manager::singleton().beacon().top().fill(color);
+    BlackBox::Manager::singleton().beacon().top().fill(args.color);
     BlackBox::Manager::singleton().beacon().show();
     for (auto& led : newState.top) {
-        led = color;
+        led = args.color;
     }
     return newState;
-}));
+}
 
-constexpr tet::Command fillPerimeter("fillPerimeter", "Fill Perimeter", std::make_tuple(color), tet::Callback<State>(+[](const State& state, const nlohmann::json& args) {
+static inline State fillPerimeterImpl(const State& state, const ColorArgs& args) {
     State newState = state;
-    Rgb color = parseColor(args["color"]);
-    BlackBox::Manager::singleton().beacon().perimeter().fill(color);
+    BlackBox::Manager::singleton().beacon().perimeter().fill(args.color);
     BlackBox::Manager::singleton().beacon().show();
     for (auto& led : newState.perim) {
-        led = color;
+        led = args.color;
     }
     return newState;
-}));
+}
 
-constexpr tet::Command fillAll("fillAll", "Fill All", std::make_tuple(color), tet::Callback<State>(+[](const State& state, const nlohmann::json& args) {
+static inline State fillAllImpl(const State& state, const ColorArgs& args) {
     State newState = state;
-    Rgb color = parseColor(args["color"]);
-    BlackBox::Manager::singleton().beacon().fill(color);
+    BlackBox::Manager::singleton().beacon().fill(args.color);
     BlackBox::Manager::singleton().beacon().show();
     for (auto& led : newState.top) {
-        led = color;
+        led = args.color;
     }
     for (auto& led : newState.perim) {
-        led = color;
+        led = args.color;
     }
     return newState;
-}));
+}
 
-constexpr tet::Command showTop("showTop", "Show Top", std::make_tuple(colorsTop), tet::Callback<State>(+[](const State& state, const nlohmann::json& args) {
+static inline State showTopImpl(const State& state, const ColorsArgs& args) {
     State newState = state;
-    auto colors = parseColors(args);
-    for (std::size_t i = 0; i < colors.size(); i++) {
-        newState.top[i] = colors[i];
+    for (std::size_t i = 0; i < args.colors.size(); i++) {
+        newState.top[i] = args.colors[i];
     }
     return newState;
-}));
+}
 
-constexpr tet::Command showPerimeter("showPerimeter", "Show Perimeter", std::make_tuple(colorsPerim), tet::Callback<State>(+[](const State& state, const nlohmann::json& args) {
+static inline State showPerimeterImpl(const State& state, const ColorsArgs& args) {
     State newState = state;
-    auto colors = parseColors(args);
-    for (std::size_t i = 0; i < colors.size(); i++) {
-        newState.perim[i] = colors[i];
+    for (std::size_t i = 0; i < args.colors.size(); i++) {
+        newState.perim[i] = args.colors[i];
     }
     return newState;
-}));
+}
+
+constexpr tet::Command openDoor("openDoor", "Open Door", std::make_tuple(index), tet::typed<State, IndexArgs, openDoorImpl>());
+constexpr tet::Command closeDoor("closeDoor", "Close Door", std::make_tuple(index), tet::typed<State, IndexArgs, closeDoorImpl>());
+constexpr tet::Command fillTop("fillTop", "Fill Top", std::make_tuple(color), tet::typed<State, ColorArgs, fillTopImpl>());
+constexpr tet::Command fillPerimeter("fillPerimeter", "Fill Perimeter", std::make_tuple(color), tet::typed<State, ColorArgs, fillPerimeterImpl>());
+constexpr tet::Command fillAll("fillAll", "Fill All", std::make_tuple(color), tet::typed<State, ColorArgs, fillAllImpl>());
+constexpr tet::Command showTop("showTop", "Show Top", std::make_tuple(colorsTop), tet::typed<State, ColorsArgs, showTopImpl>());
+constexpr tet::Command showPerimeter("showPerimeter", "Show Perimeter", std::make_tuple(colorsPerim), tet::typed<State, ColorsArgs, showPerimeterImpl>());
 
 constexpr tet::Command shutdown("shutdown", "Shutdown", std::make_tuple(), tet::Callback<State>(+[](const State& state, const nlohmann::json& args) {
     State newState = state;
@@ -1,20 +1,26 @@
 #include "HW.hpp"
 #include "commands.hpp"
 #include "events.hpp"
+#include "state.hpp"
 
 #include "MQTT.hpp"
 #include "NVS.hpp"
 #include "NetIf.hpp"
+#include "Station.hpp"
 #include "WiFi.hpp"
 #include "mDNS.hpp"
 #include "tet/Client.hpp"
+#include "tet/MqttTransport.hpp"
+#include "tet/Multicast.hpp"
 
 #include "esp_crt_bundle.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_system.h"
 
+#include <algorithm>
 #include <chrono>
+#include <exception>
 #include <iostream>
 #include <thread>
 
@@ -22,62 +28,34 @@ using namespace std::chrono_literals;
 
 using SSID = std::string;
 using Password = std::string;
-using Network = std::pair<SSID, Password>;
 using Networks = std::multimap<SSID, Password>;
 
 static const char* TAG = "main";
+static const char* s_defaultBroker = "mqtt://8.8.8.8:1883";
+// Frames and cues of light shows also arrive by UDP multicast, see tet::Multicast.
+static constexpr bool s_multicastShow = true;
 
-bool tryConnect(const Network& network) {
-    std::atomic_int success = 0;
-
-    auto& wifi = WiFi::singleton();
-
-    auto onConnected = wifi.on(WIFI_EVENT_STA_CONNECTED, [&success](const wifi_event_sta_connected_t* event) {
-        success = 1;
-        success.notify_all();
+// Connects to the best AP of any of the networks and roams when its signal gets weak. Outages are
+// bridged in the background with a backoff instead of restarting, MQTT and tet keep running meanwhile.
+void keepConnected(const Networks& networks) {
+    ESP_LOGI(TAG, "Connecting to AP");
+    static Station station([&] {
+        Station::Config config;
+        for (const auto& [ssid, password] : networks)
+            config.networks.push_back({ ssid, password });
+        return config;
+    }());
+
+    station.on(Station::State::Waiting, [](Station::State) {
+        ESP_LOGW(TAG, "No known AP reachable, retrying in the background");
     });
-
-    auto onDisconnected = wifi.on(WIFI_EVENT_STA_DISCONNECTED, [&success](const wifi_event_sta_disconnected_t* event) {
-        success = -1;
-        success.notify_all();
+    station.on(Station::State::Connected, [](Station::State) {
+        auto stats = station.stats();
+        if (stats.reconnects)
+            ESP_LOGI(TAG, "Reconnected to AP after %lu ms", static_cast<unsigned long>(stats.lastOutageMs));
     });
 
-    wifi.connect(network.first, network.second, false);
-
-    success.wait(0);
-
-    wifi.removeListener(WIFI_EVENT_STA_CONNECTED, onConnected);
-    wifi.removeListener(WIFI_EVENT_STA_DISCONNECTED, onDisconnected);
-
-    return success == 1;
-}
-
-std::optional<Network> tryConnect(Networks& networks) {
-    WiFi& wifi = WiFi::singleton();
-
-    auto available = wifi.scan();
-
-    for (const auto& entry : available) {
-        std::string ssid = reinterpret_cast<const char*>(entry.ssid);
-        auto [fst, last] = networks.equal_range(ssid);
-        for (auto it = fst; it != last; ++it) {
-            if (tryConnect(*it)) {
-                return *it;
-            }
-        }
-    }
-    return std::nullopt;
-}
-
-void keepConnected(Network network) {
-    ESP_LOGI(TAG, "Connecting to AP");
-    WiFi& wifi = WiFi::singleton();
-    !tryConnect(network);
-
-    auto onDisconnected = wifi.on(WIFI_EVENT_STA_DISCONNECTED, [=, &wifi](const wifi_event_sta_disconnected_t* event) {
-        ESP_LOGI(TAG, "Disconnected from AP");
-        esp_restart();
-    });
+    station.start();
 }
 
 bool readButton1() {
@@ -120,12 +98,14 @@ extern "C" void app_main(void) {
     snprintf(id.data(), id.size() + 1, MACSTR, MAC2STR(mac.data()));
 
     std::unique_ptr<MQTT::Client> mqtt = nullptr;
+    std::unique_ptr<tet::MqttTransport> transport = nullptr;
 
-    static constexpr auto schema = tet::makeSchema(Commands::all, Events::all);
+    static constexpr auto schema = tet::makeSchema(Commands::all, Events::all, StateFields::all);
     std::cout << schema.view() << std::endl;
     static auto callbacks = tet::makeFrozenMap<State>(Commands::all);
+    static constexpr auto opcodes = tet::makeDispatchTable<State>(Commands::all);
     using commandCount = std::tuple_size<std::decay_t<decltype(Commands::all)>>;
-    tet::Client<State, Manager, commandCount::value> client(id, schema.view(), callbacks);
+    tet::Client<State, Manager, tet::MqttTransport, commandCount::value, std::decay_t<decltype(StateFields::all)>> client(id, schema.view(), callbacks, opcodes, StateFields::all);
 
     std::atomic_flag connected = ATOMIC_FLAG_INIT;
 
@@ -135,24 +115,82 @@ extern "C" void app_main(void) {
         connected.notify_all();
     });
 
-    keepConnected(std::make_pair("MotoG5G", "haberturdeur"));
+    keepConnected({ { "MotoG5G", "haberturdeur" } });
 
-    // connected.wait(0);
+    connected.wait(0);
 
-    std::optional<mDNS::Device::ServiceResult> service;
-    // while (!(service = mdns.queryService("_tet", "_tcp")))
-        std::this_thread::sleep_for(1s);
+    // Brokers announced on the network come first, then the last one that worked, then the built-in one.
+    std::vector<std::string> brokers;
+    auto addBroker = [&](const std::string& uri) {
+        if (!uri.empty() && std::find(brokers.begin(), brokers.end(), uri) == brokers.end())
+            brokers.push_back(uri);
+    };
+    for (auto& service : mdns.queryServices("_tet", "_tcp")) {
+        ESP_LOGI(TAG, "Found service: %s:%d", service.hostname.c_str(), service.port);
+        addBroker("mqtt://" + service.ip.toString() + ":" + std::to_string(service.port));
+    }
+    NVS brokerStore("mqtt");
+    std::string lastBroker = std::get<std::string>(brokerStore.get("broker", std::string()));
+    addBroker(lastBroker);
+    addBroker(s_defaultBroker);
 
-    // ESP_LOGI(TAG, "Found service: %s:%d", service->hostname.c_str(), service->port);
     MQTT::Config mqttConfig = {
-        // .host = "mqtt://" + service->ip.toString() + ":" + std::to_string(service->port),
-        .host = "mqtt://8.8.8.8:1883",
+        .host = brokers.front(),
+        .fallbackHosts = std::vector<std::string>(brokers.begin() + 1, brokers.end()),
     };
     ESP_LOGI(TAG, "Connecting to: %s", mqttConfig.host.c_str());
     mqtt = std::make_unique<MQTT::Client>(mqttConfig);
+    mqtt->on(MQTT::Event::Id::Connected, [&](auto) {
+        std::string broker = mqtt->broker();
+        if (broker == lastBroker)
+            return;
+        brokerStore.set("broker", broker);
+        brokerStore.commit();
+        lastBroker = broker;
+    });
     mqtt->start();
 
-    client.init(mqtt.get(), &manager);
+    transport = std::make_unique<tet::MqttTransport>(*mqtt);
+    client.init(transport.get(), &manager);
+
+    // Top LEDs followed by the perimeter. Cue ids are command opcodes, the cue data is the command's data.
+    static std::array<Rgb, 60 + 52> showFrame;
+    std::unique_ptr<tet::Multicast::Listener<Rgb>> show = nullptr;
+    if (s_multicastShow) {
+        NVS showStore("show");
+        show = std::make_unique<tet::Multicast::Listener<Rgb>>(
+            tet::Multicast::Listener<Rgb>::Config {
+                .groups = showStore.getOrSet<std::uint32_t>("groups", 1),
+                .station = showStore.getOrSet<std::uint16_t>("station", 0),
+            },
+            showFrame,
+            [&client](std::size_t first, std::size_t count) {
+                // Commands fill the same LEDs from the MQTT task.
+                auto lock = client.lock();
+                auto& beacon = BlackBox::Manager::singleton().beacon();
+                for (std::size_t i = first; i < first + count; ++i) {
+                    if (i < 60)
+                        beacon.onTop(i) = showFrame[i];
+                    else
+                        beacon.onPerimeter(i - 60) = showFrame[i];
+                }
+                beacon.show();
+            },
+            [&client](std::uint16_t cue, std::string_view data) {
+                nlohmann::json json = nlohmann::json::parse(data, nullptr, false);
+                if (json.is_discarded())
+                    ESP_LOGW(TAG, "Invalid data of cue %u", static_cast<unsigned>(cue));
+                else
+                    client.executeCommand(static_cast<std::size_t>(cue), json);
+            });
+        try {
+            show->start();
+        } catch (const std::exception& e) {
+            // The device stays usable over MQTT without the show.
+            ESP_LOGE(TAG, "Multicast show disabled: %s", e.what());
+            show = nullptr;
+        }
+    }
 
     while (true) {
         // man.power().checkBatteryLevel(3700, true);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "HW.hpp"
+#include "commands.hpp"
+
+#include "tet/Argument.hpp"
+#include "tet/Field.hpp"
+
+#include <tuple>
+
+namespace StateFields {
+
+constexpr tet::Boolean door("closed", "Closed", true);
+
+// The order defines the field ids used in state deltas, append new fields at the end.
+constexpr tet::Field top(&State::top, tet::Array("top", "Top LEDs", true, Commands::color, 60, 60));
+constexpr tet::Field perim(&State::perim, tet::Array("perim", "Perimeter LEDs", true, Commands::color, 52, 52));
+constexpr tet::Field doors(&State::doors, tet::Array("doors", "Doors", true, door, 4, 4));
+constexpr tet::Field shutdown(&State::shutdown, tet::Boolean("shutdown", "Shutdown", true));
+
+constexpr auto all = std::make_tuple(top, perim, doors, shutdown);
+
+} // namespace StateFields
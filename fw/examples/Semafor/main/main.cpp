@@ -5,6 +5,7 @@
 #include "MQTT.hpp"
 #include "NVS.hpp"
 #include "NetIf.hpp"
+#include "Station.hpp"
 #include "WiFi.hpp"
 #include "mDNS.hpp"
 
@@ -23,64 +24,33 @@ using namespace std::chrono_literals;
 
 using SSID = std::string;
 using Password = std::string;
-using Network = std::pair<SSID, Password>;
 using Networks = std::multimap<SSID, Password>;
 
 static const char* TAG = "main";
 
 SmartLed g_leds(LED_WS2812B, Pins::LED_COUNT, Pins::Leds);
 
-bool tryConnect(const Network& network) {
-    std::atomic_int success = 0;
-
-    auto& wifi = WiFi::singleton();
-
-    auto onConnected = wifi.on(WIFI_EVENT_STA_CONNECTED, [&success](const wifi_event_sta_connected_t* event) {
-        success = 1;
-        success.notify_all();
+// Connects to the best AP of any of the networks and roams when its signal gets weak. Outages are
+// bridged in the background with a backoff instead of restarting, MQTT and tet keep running meanwhile.
+void keepConnected(const Networks& networks) {
+    ESP_LOGI(TAG, "Connecting to AP");
+    static Station station([&] {
+        Station::Config config;
+        for (const auto& [ssid, password] : networks)
+            config.networks.push_back({ ssid, password });
+        return config;
+    }());
+
+    station.on(Station::State::Waiting, [](Station::State) {
+        ESP_LOGW(TAG, "No known AP reachable, retrying in the background");
     });
-
-    auto onDisconnected = wifi.on(WIFI_EVENT_STA_DISCONNECTED, [&success](const wifi_event_sta_disconnected_t* event) {
-        success = -1;
-        success.notify_all();
+    station.on(Station::State::Connected, [](Station::State) {
+        auto stats = station.stats();
+        if (stats.reconnects)
+            ESP_LOGI(TAG, "Reconnected to AP after %lu ms", static_cast<unsigned long>(stats.lastOutageMs));
     });
 
-    wifi.connect(network.first, network.second, false);
-
-    success.wait(0);
-
-    wifi.removeListener(WIFI_EVENT_STA_CONNECTED, onConnected);
-    wifi.removeListener(WIFI_EVENT_STA_DISCONNECTED, onDisconnected);
-
-    return success == 1;
-}
-
-std::optional<Network> tryConnect(Networks& networks) {
-    WiFi& wifi = WiFi::singleton();
-
-    auto available = wifi.scan();
-
-    for (const auto& entry : available) {
-        std::string ssid = reinterpret_cast<const char*>(entry.ssid);
-        auto [fst, last] = networks.equal_range(ssid);
-        for (auto it = fst; it != last; ++it) {
-            if (tryConnect(*it)) {
-                return *it;
-            }
-        }
-    }
-    return std::nullopt;
-}
-
-void keepConnected(Network network) {
-    ESP_LOGI(TAG, "Connecting to AP");
-    WiFi& wifi = WiFi::singleton();
-    !tryConnect(network);
-
-    auto onDisconnected = wifi.on(WIFI_EVENT_STA_DISCONNECTED, [=, &wifi](const wifi_event_sta_disconnected_t* event) {
-        ESP_LOGI(TAG, "Disconnected from AP");
-        esp_restart();
-    });
+    station.start();
 }
 
 void initPins() {
@@ -187,7 +157,7 @@ extern "C" void app_main(void) {
         connected.notify_all();
     });
 
-    keepConnected(std::make_pair("MotoG5G", "haberturdeur"));
+    keepConnected({ { "MotoG5G", "haberturdeur" } });
 
     connected.wait(0);
 
@@ -13,11 +13,11 @@
 
 namespace Commands {
 
-constexpr tet::Number red("r", "Red", true);
-constexpr tet::Number green("g", "Green", true);
-constexpr tet::Number blue("b", "Blue", true);
+constexpr tet::Number red("r", "Red", true, 0, 255);
+constexpr tet::Number green("g", "Green", true, 0, 255);
+constexpr tet::Number blue("b", "Blue", true, 0, 255);
 
-constexpr tet::Number index("index", "Index", true);
+constexpr tet::Number index("index", "Index", true, 0, 4);
 
 constexpr tet::Object color("color", "Color", true, std::make_tuple(red, green, blue));
 constexpr tet::Array colors("colors", "Colors", true, color, 5, 5);
@@ -3,6 +3,7 @@
 #include "events.hpp"
 
 #include "tet/Client.hpp"
+#include "tet/MqttTransport.hpp"
 #include "MQTT.hpp"
 
 #include <chrono>
@@ -10,9 +11,11 @@
 extern "C" void app_main(void) {
     Manager manager;
     MQTT::Client mqtt("mqtts://mqtt.gwenlian.eu:8883", "tet", "tet");
+    tet::MqttTransport transport(mqtt);
 
     static constexpr auto schema = tet::makeSchema(Commands::all, Events::all);
     static auto callbacks = tet::makeFrozenMap<State>(Commands::all);
-    tet::Client<State, Manager, std::tuple_size_v<decltype(Commands::all)>> client("tet", schema.view(), callbacks);
-    client.init(&mqtt, &manager);
+    static constexpr auto opcodes = tet::makeDispatchTable<State>(Commands::all);
+    tet::Client<State, Manager, tet::MqttTransport, std::tuple_size_v<decltype(Commands::all)>> client("tet", schema.view(), callbacks, opcodes);
+    client.init(&transport, &manager);
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+/**
+ * Decoder for the heatshrink compressed payloads sent by the firmware.
+ *
+ * A compressed payload starts with a NUL byte followed by 'hs', then the
+ * uncompressed size as 32-bit little endian and the heatshrink stream. The
+ * firmware uses a 256 byte window and a 16 byte lookahead, so a back reference
+ * is an 8 bit offset and a 4 bit count.
+ */
+
+const magic = Buffer.from([0x00, 0x68, 0x73]); // "\0hs"
+const headerSize = magic.length + 4;
+const windowBits = 8;
+const lookaheadBits = 4;
+
+export function isCompressed(payload: Buffer): boolean {
+    return payload.length >= headerSize && payload.subarray(0, magic.length).equals(magic);
+}
+
+/**
+ * @brief Decompress a payload
+ *
+ * @param payload - A payload for which isCompressed() holds
+ * @param limit - Largest accepted uncompressed size
+ *
+ * @return The uncompressed payload, or null if it is corrupt or larger than the limit
+ */
+export function decompress(payload: Buffer, limit: number = 16 * 1024): Buffer | null {
+    if (!isCompressed(payload))
+        return null;
+    const size = payload.readUInt32LE(magic.length);
+    if (size > limit)
+        return null;
+
+    const out = Buffer.alloc(size);
+    let written = 0;
+    let bit = headerSize * 8;
+    const end = payload.length * 8;
+
+    // Bits are read most significant first, null once the stream is exhausted.
+    const read = (count: number): number | null => {
+        if (bit + count > end)
+            return null;
+        let value = 0;
+        for (let i = 0; i < count; ++i, ++bit)
+            value = (value << 1) | ((payload[bit >> 3] >> (7 - (bit & 7))) & 1);
+        return value;
+    };
+
+    for (;;) {
+        const tag = read(1);
+        if (tag === null)
+            break;
+        if (tag) {
+            const literal = read(8);
+            if (literal === null)
+                break;
+            if (written === size)
+                return null;
+            out[written++] = literal;
+            continue;
+        }
+
+        const index = read(windowBits);
+        const count = index === null ? null : read(lookaheadBits);
+        if (index === null || count === null)
+            break; // Padding of the last byte.
+        const offset = index + 1;
+        if (written + count + 1 > size)
+            return null;
+        // Like the firmware's decoder, the window starts out filled with zeros.
+        for (let i = 0; i <= count; ++i, ++written)
+            out[written] = written >= offset ? out[written - offset] : 0;
+    }
+
+    return written === size ? out : null;
+}
@@ -2,6 +2,7 @@ import { InvalidStateError } from '../errors/index.js';
 import { TypedEventEmitter } from '../utils/TypedEventEmitter.js';
 import { createLogger } from '../log/index.js';
 import { ConnectionEventCallbacks, IConnection } from './interfaces/IConnection.js';
+import { decompress, isCompressed } from './Heatshrink.js';
 import MQTT from 'async-mqtt';
 
 const logger = createLogger('MQTTConnection');
@@ -32,6 +33,14 @@ export class MQTTConnection extends TypedEventEmitter<ConnectionEventCallbacks>
         });
 
         this.client.on('message', (topic, payload) => {
+            if (isCompressed(payload)) {
+                const inflated = decompress(payload);
+                if (!inflated) {
+                    logger.warn(`Dropped undecodable compressed message on topic ${topic}`);
+                    return;
+                }
+                payload = inflated;
+            }
             const payloadString = payload.toString('utf8');
             logger.debug(`Received message on topic ${topic}: ${payloadString}`);
             this.emit('message', {
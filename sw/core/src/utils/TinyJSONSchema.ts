@@ -8,6 +8,8 @@ type CommonData = {
 export type StringSchema = CommonData & {
     type: 'string';
     enum?: string[];
+    minLength?: number;
+    maxLength?: number;
 };
 
 export type NumberSchema = CommonData & {
@@ -46,9 +48,15 @@ export type ArraySchema = CommonData & {
 
 export type TinyJSONSchema = StringSchema | NumberSchema | BooleanSchema | NullSchema | IntegerSchema | ObjectSchema | ArraySchema;
 
-export const tinyJSONSchemaString = t.type({
-    type: t.literal('string'),
-}, 'TinyJSONSchemaString');
+export const tinyJSONSchemaString = t.intersection([
+    t.type({
+        type: t.literal('string'),
+    }),
+    t.partial({
+        minLength: t.number,
+        maxLength: t.number,
+    }),
+], 'TinyJSONSchemaString');
 
 export const tinyJSONSchemaNumber = t.intersection([
     t.type({
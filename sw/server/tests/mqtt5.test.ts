@@ -0,0 +1,97 @@
+import { afterEach, describe, expect, test } from '@jest/globals';
+import mqtt, { type IConnackPacket, type MqttClient } from 'mqtt';
+
+/**
+ * Interop of the firmware's MQTT 5 topic aliases with the mosquitto from
+ * ../mosquitto, e.g. started by `docker-compose up mosquitto`.
+ *
+ * TET_BROKER overrides the broker URL. The device tests run only with
+ * TET_DEVICE set to the id of a device on the same broker, built with
+ * MQTT::Version::V5 and topic aliases. TET_DEVICE_CLIENT_ID is its MQTT client
+ * id, used to take its connection over and make it reconnect.
+ */
+const broker = process.env.TET_BROKER ?? 'mqtt://127.0.0.1:1883';
+const device = process.env.TET_DEVICE;
+const deviceClientId = process.env.TET_DEVICE_CLIENT_ID;
+
+const timeout = 30000;
+
+const clients: MqttClient[] = [];
+
+async function connect(): Promise<MqttClient> {
+    const client = await mqtt.connectAsync(broker, { protocolVersion: 5, reconnectPeriod: 0 });
+    clients.push(client);
+    return client;
+}
+
+// Resolves with the topics of the next `count` messages the client receives.
+function receive(client: MqttClient, count: number, waitMs: number): Promise<string[]> {
+    const topics: string[] = [];
+    return new Promise<string[]>((resolve, reject) => {
+        const timer = setTimeout(() => reject(new Error(`Received ${topics.length} of ${count} messages`)), waitMs);
+        client.on('message', topic => {
+            topics.push(topic);
+            if (topics.length === count) {
+                clearTimeout(timer);
+                resolve(topics);
+            }
+        });
+    });
+}
+
+afterEach(async () => {
+    await Promise.all(clients.splice(0).map(client => client.endAsync(true)));
+});
+
+describe('mosquitto topic aliases', () => {
+    test('resolves alias-only publishes after the alias was announced', async () => {
+        const subscriber = await connect();
+        const publisher = await connect();
+
+        await subscriber.subscribeAsync('tet/interop/alias');
+        const received = receive(subscriber, 3, 5000);
+        // The pattern MQTT::Client uses: topic and alias first, then only the alias.
+        await publisher.publishAsync('tet/interop/alias', 'first', { qos: 0, properties: { topicAlias: 1 } });
+        await publisher.publishAsync('', 'second', { qos: 0, properties: { topicAlias: 1 } });
+        await publisher.publishAsync('', 'third', { qos: 0, properties: { topicAlias: 1 } });
+
+        expect(await received).toEqual(['tet/interop/alias', 'tet/interop/alias', 'tet/interop/alias']);
+    }, timeout);
+
+    test('accepts as many aliases as the firmware uses by default', async () => {
+        const connack = await new Promise<IConnackPacket>((resolve, reject) => {
+            const client = mqtt.connect(broker, { protocolVersion: 5, reconnectPeriod: 0 });
+            clients.push(client);
+            client.once('connect', resolve);
+            client.once('error', reject);
+        });
+        // MQTT::Config::topicAliases
+        expect(connack.properties?.topicAliasMaximum).toBeGreaterThanOrEqual(10);
+    }, timeout);
+});
+
+describe('device topic aliases', () => {
+    const deviceTest = device ? test : test.skip;
+    const reconnectTest = device && deviceClientId ? test : test.skip;
+
+    deviceTest('device messages arrive under their full topics', async () => {
+        const subscriber = await connect();
+        await subscriber.subscribeAsync(`tet/devices/${device}/#`);
+        const topics = await receive(subscriber, 20, 20000);
+        for (const topic of topics)
+            expect(topic.startsWith(`tet/devices/${device}/`)).toBe(true);
+    }, timeout);
+
+    reconnectTest('device keeps publishing after its connection is replaced', async () => {
+        // Connecting with the device's client id makes the broker drop the device, which then reconnects.
+        // Reusing an alias from the old connection would get it disconnected again for a protocol error.
+        const takeover = await mqtt.connectAsync(broker, { protocolVersion: 5, clientId: deviceClientId, reconnectPeriod: 0 });
+        await takeover.endAsync(true);
+
+        const subscriber = await connect();
+        await subscriber.subscribeAsync(`tet/devices/${device}/#`);
+        const topics = await receive(subscriber, 20, 25000);
+        for (const topic of topics)
+            expect(topic.startsWith(`tet/devices/${device}/`)).toBe(true);
+    }, timeout);
+});